@@ -0,0 +1,145 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief Times smooth, sharpen and edge detection (the Sobel pass) with and
+ * without stride padding, on a width whose rows alias in the cache and on
+ * one whose rows do not. Built apart from prog1:
+ *
+ *     g++ -O2 -std=c++14 -pthread -I.. strideBenchmark.cpp
+ *         ../colorSpace.cpp ../histogram.cpp ../imageFileIO.cpp
+ *         ../imageOperations.cpp ../memory.cpp ../pointOperations.cpp
+ *         ../simdKernels.cpp ../summedArea.cpp ../tiling.cpp
+ *         ../utilities.cpp -o strideBenchmark
+ *
+ * Run as strideBenchmark [rows] [runs], 3072 rows and the best of 5 runs if
+ * not given.
+ ****************************************************************************/
+
+#include <chrono>
+#include <iomanip>
+#include "netPBM.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes a color image of made up values, allocated with the stride padding
+ * set at the time
+ *
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ *
+ * @returns returns the image
+ *
+ *****************************************************************************/
+static image testImage(int rows, int cols)
+{
+    pixel** bands[3];
+    unsigned seed = 12345;
+    image img;
+    int c, i, j;
+
+    img.rows = rows;
+    img.cols = cols;
+    for (c = 0; c < 3; c++)
+    {
+        bands[c] = alloc2D(rows, cols);
+        for (i = 0; i < rows; i++)
+        {
+            for (j = 0; j < cols; j++)
+            {
+                seed = seed * 1103515245 + 12345;
+                bands[c][i][j] = (pixel)(seed >> 16);
+            }
+        }
+    }
+    img.redgray = bands[0];
+    img.green = bands[1];
+    img.blue = bands[2];
+
+    return img;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Times an operation on a fresh image, leaving out making the image
+ *
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ * @param[in] padding - stride padding in bytes
+ * @param[in] runs - number of runs, the fastest is kept
+ * @param[in] work - operation to time
+ *
+ * @returns returns the fastest run in milliseconds
+ *
+ *****************************************************************************/
+static double bestTime(int rows, int cols, int padding, int runs,
+    const function<void(image&)>& work)
+{
+    double best = 0, ms;
+    image img;
+    int run;
+
+    setStridePadding(padding);
+    for (run = 0; run < runs; run++)
+    {
+        img = testImage(rows, cols);
+
+        auto start = chrono::steady_clock::now();
+        work(img);
+        auto stop = chrono::steady_clock::now();
+
+        ms = chrono::duration<double, milli>(stop - start).count();
+        if (run == 0 || ms < best) best = ms;
+        freeImage(img);
+    }
+
+    return best;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Prints a table of times in milliseconds, padding 0 / padding 64, for a
+ * width of 4096, whose rows alias, and 4000, whose rows are not padded
+ *
+ * @param[in] argc - number of arguments supplied
+ * @param[in] argv - rows and runs, both optional
+ *
+ * @returns returns the exit code
+ *
+ *****************************************************************************/
+int main(int argc, char** argv)
+{
+    int rows = argc > 1 ? max(atoi(argv[1]), 16) : 3072;
+    int runs = argc > 2 ? max(atoi(argv[2]), 1) : 5;
+    const int widths[2] = { 4096, 4000 };
+    const char* names[4] = { "smooth r1", "smooth r5", "sharpen", "sobel (-e)" };
+    const function<void(image&)> works[4] =
+    {
+        [](image& img) { imageSmooth(img, 1); },
+        [](image& img) { imageSmooth(img, 5); },
+        [](image& img) { imageSharpen(img); },
+        [](image& img) { imageEdgeDetection(img); }
+    };
+    int k, w;
+
+    cout << rows << " rows, best of " << runs << ", ms with padding 0 / 64" << endl;
+    cout << setw(12) << "" << setw(24) << "4096 cols (aliasing)"
+        << setw(24) << "4000 cols (not padded)" << endl;
+    for (k = 0; k < 4; k++)
+    {
+        cout << setw(12) << left << names[k] << right << fixed << setprecision(1);
+        for (w = 0; w < 2; w++)
+        {
+            cout << setw(14) << bestTime(rows, widths[w], 0, runs, works[k])
+                << " / " << setw(7) << bestTime(rows, widths[w], 64, runs, works[k]);
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
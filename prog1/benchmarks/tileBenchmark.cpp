@@ -0,0 +1,159 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief Times sharpen and smooth over tiles of several sizes, on an image
+ * larger than the last level cache, so the tile size picked by TILE_ROWS
+ * and TILE_COLS can be checked. A tile of the whole image does each
+ * colorband of a thread's rows in one sweep, as if there were no tiles.
+ * Built apart from prog1:
+ *
+ *     g++ -O2 -std=c++14 -pthread -I.. tileBenchmark.cpp
+ *         ../colorSpace.cpp ../histogram.cpp ../imageFileIO.cpp
+ *         ../imageOperations.cpp ../memory.cpp ../pointOperations.cpp
+ *         ../simdKernels.cpp ../summedArea.cpp ../tiling.cpp
+ *         ../utilities.cpp -o tileBenchmark
+ *
+ * Run as tileBenchmark [rows] [cols] [runs], an 8000x8000 image (192 MB of
+ * colorbands) and the best of 3 runs if not given.
+ ****************************************************************************/
+
+#include <chrono>
+#include <iomanip>
+#include "netPBM.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes a color image of made up values
+ *
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ *
+ * @returns returns the image
+ *
+ *****************************************************************************/
+static image testImage(int rows, int cols)
+{
+    pixel** bands[3];
+    unsigned seed = 12345;
+    image img;
+    int c, i, j;
+
+    img.rows = rows;
+    img.cols = cols;
+    for (c = 0; c < 3; c++)
+    {
+        bands[c] = alloc2D(rows, cols);
+        for (i = 0; i < rows; i++)
+        {
+            for (j = 0; j < cols; j++)
+            {
+                seed = seed * 1103515245 + 12345;
+                bands[c][i][j] = (pixel)(seed >> 16);
+            }
+        }
+    }
+    img.redgray = bands[0];
+    img.green = bands[1];
+    img.blue = bands[2];
+
+    return img;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Times an operation on a fresh image with a tile size, leaving out making
+ * the image
+ *
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ * @param[in] tileRows - rows in a tile
+ * @param[in] tileCols - columns in a tile
+ * @param[in] runs - number of runs, the fastest is kept
+ * @param[in] work - operation to time
+ *
+ * @returns returns the fastest run in milliseconds
+ *
+ *****************************************************************************/
+static double bestTime(int rows, int cols, int tileRows, int tileCols,
+    int runs, const function<void(image&)>& work)
+{
+    double best = 0, ms;
+    image img;
+    int run;
+
+    setTileSize(tileRows, tileCols);
+    for (run = 0; run < runs; run++)
+    {
+        img = testImage(rows, cols);
+
+        auto start = chrono::steady_clock::now();
+        work(img);
+        auto stop = chrono::steady_clock::now();
+
+        ms = chrono::duration<double, milli>(stop - start).count();
+        if (run == 0 || ms < best) best = ms;
+        freeImage(img);
+    }
+
+    return best;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Prints a table of times in milliseconds for each tile size
+ *
+ * @param[in] argc - number of arguments supplied
+ * @param[in] argv - rows, columns and runs, all optional
+ *
+ * @returns returns the exit code
+ *
+ *****************************************************************************/
+int main(int argc, char** argv)
+{
+    int rows = argc > 1 ? max(atoi(argv[1]), 16) : 8000;
+    int cols = argc > 2 ? max(atoi(argv[2]), 16) : 8000;
+    int runs = argc > 3 ? max(atoi(argv[3]), 1) : 3;
+    const int tiles[][2] = { { 16, 256 }, { 32, 256 }, { 64, 512 },
+        { 128, 1024 }, { 256, 2048 }, { 64, cols }, { rows, cols } };
+    const char* names[3] = { "sharpen", "smooth 3x3", "smooth r8" };
+    const function<void(image&)> works[3] =
+    {
+        [](image& img) { imageSharpen(img); },
+        [](image& img) { imageSmooth(img, 1); },
+        [](image& img) { imageSmooth(img, 8); }
+    };
+    int k, t;
+
+    cout << rows << "x" << cols << ", best of " << runs << ", ms" << endl;
+    cout << setw(12) << "tile";
+    for (k = 0; k < 3; k++)
+    {
+        cout << setw(12) << names[k];
+    }
+    cout << endl << fixed << setprecision(1);
+
+    for (t = 0; t < (int)(sizeof(tiles) / sizeof(tiles[0])); t++)
+    {
+        if (tiles[t][0] == rows && tiles[t][1] == cols)
+        {
+            cout << setw(12) << "whole image";
+        }
+        else {
+            cout << setw(12) << to_string(tiles[t][0]) + "x" + to_string(tiles[t][1]);
+        }
+        for (k = 0; k < 3; k++)
+        {
+            cout << setw(12) << bestTime(rows, cols, tiles[t][0], tiles[t][1],
+                runs, works[k]);
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
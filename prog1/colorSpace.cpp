@@ -0,0 +1,988 @@
+/** **************************************************************************
+ * @file
+ * 
+ * @brief The source code for converting the colorbands of an image between
+ * RGB and other color spaces
+ ****************************************************************************/
+
+#include "netPBM.h"
+#include "simd.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Rounds a fixed point number with YCC_SHIFT fraction bits to an integer
+ * and crops it to [0, 255]
+ *
+ * @param[in] num - fixed point number
+ *
+ * @returns returns the color value
+ *
+ *****************************************************************************/
+static pixel fixedToPixel(int num)
+{
+    return cropNum((num + YCC_HALF) >> YCC_SHIFT);
+}
+
+#ifdef SIMD_X86
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Computes two sums of products of 16 bit value pairs with weight pairs,
+ * rounds them from fixed point and packs 8 results into 16 bit values
+ *
+ * @param[in] aLo - first 4 value pairs of the first set, as 16 bit values
+ * @param[in] aHi - last 4 value pairs of the first set
+ * @param[in] wa - weights for the first set, in the same layout
+ * @param[in] bLo - first 4 value pairs of the second set
+ * @param[in] bHi - last 4 value pairs of the second set
+ * @param[in] wb - weights for the second set
+ * @param[in] bias - amount added before rounding, as 32 bit values
+ *
+ * @returns returns the rounded values, as 16 bit values
+ *
+ *****************************************************************************/
+TARGET_SSE2 static __m128i weighPairs(__m128i aLo, __m128i aHi, __m128i wa,
+    __m128i bLo, __m128i bHi, __m128i wb, __m128i bias)
+{
+    __m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(aLo, wa),
+        _mm_madd_epi16(bLo, wb)), bias);
+    __m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(aHi, wa),
+        _mm_madd_epi16(bHi, wb)), bias);
+
+    return _mm_packs_epi32(_mm_srai_epi32(lo, YCC_SHIFT),
+        _mm_srai_epi32(hi, YCC_SHIFT));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a vector of 16 bit weight pairs
+ *
+ * @param[in] first - weight for the first value of each pair
+ * @param[in] second - weight for the second value of each pair
+ *
+ * @returns returns the weight vector
+ *
+ *****************************************************************************/
+TARGET_SSE2 static __m128i weightPair(int first, int second)
+{
+    return _mm_set1_epi32((int)((unsigned)(second & 0xFFFF) << 16
+        | (unsigned)(first & 0xFFFF)));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts 8 pixels from RGB to YCbCr, given as 16 bit values
+ *
+ * @param[in] r - red values
+ * @param[in] g - green values
+ * @param[in] b - blue values
+ * @param[out] y - luma values
+ * @param[out] cb - blue difference values
+ * @param[out] cr - red difference values
+ *
+ *****************************************************************************/
+TARGET_SSE2 static void toYCbCr8(__m128i r, __m128i g, __m128i b, __m128i& y,
+    __m128i& cb, __m128i& cr)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lumaBias = _mm_set1_epi32(YCC_HALF);
+    const __m128i chromaBias = _mm_set1_epi32((128 << YCC_SHIFT) + YCC_HALF);
+    __m128i rgLo = _mm_unpacklo_epi16(r, g), rgHi = _mm_unpackhi_epi16(r, g);
+    __m128i bLo = _mm_unpacklo_epi16(b, zero), bHi = _mm_unpackhi_epi16(b, zero);
+
+    y = weighPairs(rgLo, rgHi, weightPair(Y_R, Y_G), bLo, bHi,
+        weightPair(Y_B, 0), lumaBias);
+    cb = weighPairs(rgLo, rgHi, weightPair(-CB_R, -CB_G), bLo, bHi,
+        weightPair(CB_B, 0), chromaBias);
+    cr = weighPairs(rgLo, rgHi, weightPair(CR_R, -CR_G), bLo, bHi,
+        weightPair(-CR_B, 0), chromaBias);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from RGB to YCbCr 16 pixels at a time with SSE2
+ *
+ * @param[in,out] red - red values, replaced by luma
+ * @param[in,out] green - green values, replaced by blue difference
+ * @param[in,out] blue - blue values, replaced by red difference
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns converted, a multiple of 16
+ *
+ *****************************************************************************/
+TARGET_SSE2 static int toYCbCrRowSSE2(pixel* red, pixel* green, pixel* blue,
+    int cols)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i r, g, b, y[2], cb[2], cr[2];
+    int j;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        r = _mm_loadu_si128((const __m128i*)(red + j));
+        g = _mm_loadu_si128((const __m128i*)(green + j));
+        b = _mm_loadu_si128((const __m128i*)(blue + j));
+
+        toYCbCr8(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero),
+            _mm_unpacklo_epi8(b, zero), y[0], cb[0], cr[0]);
+        toYCbCr8(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero),
+            _mm_unpackhi_epi8(b, zero), y[1], cb[1], cr[1]);
+
+        _mm_storeu_si128((__m128i*)(red + j), _mm_packus_epi16(y[0], y[1]));
+        _mm_storeu_si128((__m128i*)(green + j), _mm_packus_epi16(cb[0], cb[1]));
+        _mm_storeu_si128((__m128i*)(blue + j), _mm_packus_epi16(cr[0], cr[1]));
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts 8 pixels from YCbCr to RGB, given as 16 bit values with 128
+ * already taken off the differences
+ *
+ * @param[in] y - luma values
+ * @param[in] cb - blue difference values
+ * @param[in] cr - red difference values
+ * @param[out] r - red values
+ * @param[out] g - green values
+ * @param[out] b - blue values
+ *
+ *****************************************************************************/
+TARGET_SSE2 static void toRGB8(__m128i y, __m128i cb, __m128i cr, __m128i& r,
+    __m128i& g, __m128i& b)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi32(YCC_HALF);
+    __m128i ycrLo = _mm_unpacklo_epi16(y, cr), ycrHi = _mm_unpackhi_epi16(y, cr);
+    __m128i ycbLo = _mm_unpacklo_epi16(y, cb), ycbHi = _mm_unpackhi_epi16(y, cb);
+    __m128i crLo = _mm_unpacklo_epi16(cr, zero), crHi = _mm_unpackhi_epi16(cr, zero);
+
+    r = weighPairs(ycrLo, ycrHi, weightPair(YCC_ONE, R_CR), zero, zero, zero, bias);
+    g = weighPairs(ycbLo, ycbHi, weightPair(YCC_ONE, -G_CB), crLo, crHi,
+        weightPair(-G_CR, 0), bias);
+    b = weighPairs(ycbLo, ycbHi, weightPair(YCC_ONE, B_CB), zero, zero, zero, bias);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from YCbCr to RGB 16 pixels at a time with SSE2
+ *
+ * @param[in,out] red - luma values, replaced by red
+ * @param[in,out] green - blue difference values, replaced by green
+ * @param[in,out] blue - red difference values, replaced by blue
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns converted, a multiple of 16
+ *
+ *****************************************************************************/
+TARGET_SSE2 static int toRGBRowSSE2(pixel* red, pixel* green, pixel* blue,
+    int cols)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    __m128i y, cb, cr, r[2], g[2], b[2];
+    int j;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        y = _mm_loadu_si128((const __m128i*)(red + j));
+        cb = _mm_loadu_si128((const __m128i*)(green + j));
+        cr = _mm_loadu_si128((const __m128i*)(blue + j));
+
+        toRGB8(_mm_unpacklo_epi8(y, zero),
+            _mm_sub_epi16(_mm_unpacklo_epi8(cb, zero), half),
+            _mm_sub_epi16(_mm_unpacklo_epi8(cr, zero), half), r[0], g[0], b[0]);
+        toRGB8(_mm_unpackhi_epi8(y, zero),
+            _mm_sub_epi16(_mm_unpackhi_epi8(cb, zero), half),
+            _mm_sub_epi16(_mm_unpackhi_epi8(cr, zero), half), r[1], g[1], b[1]);
+
+        _mm_storeu_si128((__m128i*)(red + j), _mm_packus_epi16(r[0], r[1]));
+        _mm_storeu_si128((__m128i*)(green + j), _mm_packus_epi16(g[0], g[1]));
+        _mm_storeu_si128((__m128i*)(blue + j), _mm_packus_epi16(b[0], b[1]));
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Computes two sums of products of 16 bit value pairs with weight pairs,
+ * rounds them from fixed point and packs 16 results into 16 bit values.
+ * The results are in the order of the values within each 128 bit half.
+ *
+ * @param[in] aLo - first 8 value pairs of the first set, as 16 bit values
+ * @param[in] aHi - last 8 value pairs of the first set
+ * @param[in] wa - weights for the first set, in the same layout
+ * @param[in] bLo - first 8 value pairs of the second set
+ * @param[in] bHi - last 8 value pairs of the second set
+ * @param[in] wb - weights for the second set
+ * @param[in] bias - amount added before rounding, as 32 bit values
+ *
+ * @returns returns the rounded values, as 16 bit values
+ *
+ *****************************************************************************/
+TARGET_AVX2 static __m256i weighPairsAVX2(__m256i aLo, __m256i aHi,
+    __m256i wa, __m256i bLo, __m256i bHi, __m256i wb, __m256i bias)
+{
+    __m256i lo = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(aLo, wa),
+        _mm256_madd_epi16(bLo, wb)), bias);
+    __m256i hi = _mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(aHi, wa),
+        _mm256_madd_epi16(bHi, wb)), bias);
+
+    return _mm256_packs_epi32(_mm256_srai_epi32(lo, YCC_SHIFT),
+        _mm256_srai_epi32(hi, YCC_SHIFT));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a 256 bit vector of 16 bit weight pairs
+ *
+ * @param[in] first - weight for the first value of each pair
+ * @param[in] second - weight for the second value of each pair
+ *
+ * @returns returns the weight vector
+ *
+ *****************************************************************************/
+TARGET_AVX2 static __m256i weightPairAVX2(int first, int second)
+{
+    return _mm256_set1_epi32((int)((unsigned)(second & 0xFFFF) << 16
+        | (unsigned)(first & 0xFFFF)));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts 16 pixels from RGB to YCbCr, given as 16 bit values
+ *
+ * @param[in] r - red values
+ * @param[in] g - green values
+ * @param[in] b - blue values
+ * @param[out] y - luma values
+ * @param[out] cb - blue difference values
+ * @param[out] cr - red difference values
+ *
+ *****************************************************************************/
+TARGET_AVX2 static void toYCbCr16(__m256i r, __m256i g, __m256i b,
+    __m256i& y, __m256i& cb, __m256i& cr)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lumaBias = _mm256_set1_epi32(YCC_HALF);
+    const __m256i chromaBias = _mm256_set1_epi32((128 << YCC_SHIFT) + YCC_HALF);
+    __m256i rgLo = _mm256_unpacklo_epi16(r, g), rgHi = _mm256_unpackhi_epi16(r, g);
+    __m256i bLo = _mm256_unpacklo_epi16(b, zero), bHi = _mm256_unpackhi_epi16(b, zero);
+
+    y = weighPairsAVX2(rgLo, rgHi, weightPairAVX2(Y_R, Y_G), bLo, bHi,
+        weightPairAVX2(Y_B, 0), lumaBias);
+    cb = weighPairsAVX2(rgLo, rgHi, weightPairAVX2(-CB_R, -CB_G), bLo, bHi,
+        weightPairAVX2(CB_B, 0), chromaBias);
+    cr = weighPairsAVX2(rgLo, rgHi, weightPairAVX2(CR_R, -CR_G), bLo, bHi,
+        weightPairAVX2(-CR_B, 0), chromaBias);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from RGB to YCbCr 32 pixels at a time with AVX2. Every
+ * unpack is undone by a pack within the same 128 bit half, so the pixels
+ * come back out in order.
+ *
+ * @param[in,out] red - red values, replaced by luma
+ * @param[in,out] green - green values, replaced by blue difference
+ * @param[in,out] blue - blue values, replaced by red difference
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns converted, a multiple of 32
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int toYCbCrRowAVX2(pixel* red, pixel* green, pixel* blue,
+    int cols)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i r, g, b, y[2], cb[2], cr[2];
+    int j;
+
+    for (j = 0; j + 32 <= cols; j += 32)
+    {
+        r = _mm256_loadu_si256((const __m256i*)(red + j));
+        g = _mm256_loadu_si256((const __m256i*)(green + j));
+        b = _mm256_loadu_si256((const __m256i*)(blue + j));
+
+        toYCbCr16(_mm256_unpacklo_epi8(r, zero), _mm256_unpacklo_epi8(g, zero),
+            _mm256_unpacklo_epi8(b, zero), y[0], cb[0], cr[0]);
+        toYCbCr16(_mm256_unpackhi_epi8(r, zero), _mm256_unpackhi_epi8(g, zero),
+            _mm256_unpackhi_epi8(b, zero), y[1], cb[1], cr[1]);
+
+        _mm256_storeu_si256((__m256i*)(red + j), _mm256_packus_epi16(y[0], y[1]));
+        _mm256_storeu_si256((__m256i*)(green + j), _mm256_packus_epi16(cb[0], cb[1]));
+        _mm256_storeu_si256((__m256i*)(blue + j), _mm256_packus_epi16(cr[0], cr[1]));
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts 16 pixels from YCbCr to RGB, given as 16 bit values with 128
+ * already taken off the differences
+ *
+ * @param[in] y - luma values
+ * @param[in] cb - blue difference values
+ * @param[in] cr - red difference values
+ * @param[out] r - red values
+ * @param[out] g - green values
+ * @param[out] b - blue values
+ *
+ *****************************************************************************/
+TARGET_AVX2 static void toRGB16(__m256i y, __m256i cb, __m256i cr,
+    __m256i& r, __m256i& g, __m256i& b)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi32(YCC_HALF);
+    __m256i ycrLo = _mm256_unpacklo_epi16(y, cr), ycrHi = _mm256_unpackhi_epi16(y, cr);
+    __m256i ycbLo = _mm256_unpacklo_epi16(y, cb), ycbHi = _mm256_unpackhi_epi16(y, cb);
+    __m256i crLo = _mm256_unpacklo_epi16(cr, zero), crHi = _mm256_unpackhi_epi16(cr, zero);
+
+    r = weighPairsAVX2(ycrLo, ycrHi, weightPairAVX2(YCC_ONE, R_CR), zero, zero,
+        zero, bias);
+    g = weighPairsAVX2(ycbLo, ycbHi, weightPairAVX2(YCC_ONE, -G_CB), crLo, crHi,
+        weightPairAVX2(-G_CR, 0), bias);
+    b = weighPairsAVX2(ycbLo, ycbHi, weightPairAVX2(YCC_ONE, B_CB), zero, zero,
+        zero, bias);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from YCbCr to RGB 32 pixels at a time with AVX2
+ *
+ * @param[in,out] red - luma values, replaced by red
+ * @param[in,out] green - blue difference values, replaced by green
+ * @param[in,out] blue - red difference values, replaced by blue
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns converted, a multiple of 32
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int toRGBRowAVX2(pixel* red, pixel* green, pixel* blue,
+    int cols)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+    __m256i y, cb, cr, r[2], g[2], b[2];
+    int j;
+
+    for (j = 0; j + 32 <= cols; j += 32)
+    {
+        y = _mm256_loadu_si256((const __m256i*)(red + j));
+        cb = _mm256_loadu_si256((const __m256i*)(green + j));
+        cr = _mm256_loadu_si256((const __m256i*)(blue + j));
+
+        toRGB16(_mm256_unpacklo_epi8(y, zero),
+            _mm256_sub_epi16(_mm256_unpacklo_epi8(cb, zero), half),
+            _mm256_sub_epi16(_mm256_unpacklo_epi8(cr, zero), half), r[0], g[0], b[0]);
+        toRGB16(_mm256_unpackhi_epi8(y, zero),
+            _mm256_sub_epi16(_mm256_unpackhi_epi8(cb, zero), half),
+            _mm256_sub_epi16(_mm256_unpackhi_epi8(cr, zero), half), r[1], g[1], b[1]);
+
+        _mm256_storeu_si256((__m256i*)(red + j), _mm256_packus_epi16(r[0], r[1]));
+        _mm256_storeu_si256((__m256i*)(green + j), _mm256_packus_epi16(g[0], g[1]));
+        _mm256_storeu_si256((__m256i*)(blue + j), _mm256_packus_epi16(b[0], b[1]));
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Loads 8 color values as 32 bit values
+ *
+ * @param[in] values - the color values
+ *
+ * @returns returns the widened values
+ *
+ *****************************************************************************/
+TARGET_AVX2 static __m256i loadWide(const pixel* values)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)values));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Stores 8 32 bit values in [0, 255] as color values
+ *
+ * @param[out] values - the color values
+ * @param[in] wide - the 32 bit values
+ *
+ *****************************************************************************/
+TARGET_AVX2 static void storeWide(pixel* values, __m256i wide)
+{
+    __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(wide),
+        _mm256_extracti128_si256(wide, 1));
+
+    _mm_storel_epi64((__m128i*)values, _mm_packus_epi16(words, words));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Divides 8 non-negative 32 bit values by 8 positive ones, rounding down.
+ * Both are below 2^24, so they are exact as floats, and the quotient of
+ * every pair is either a whole number, which the division gets exactly,
+ * or further from one than a float's rounding error.
+ *
+ * @param[in] num - numerators
+ * @param[in] den - denominators
+ *
+ * @returns returns the quotients
+ *
+ *****************************************************************************/
+TARGET_AVX2 static __m256i divideWide(__m256i num, __m256i den)
+{
+    return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(num),
+        _mm256_cvtepi32_ps(den)));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from RGB to HSV 8 pixels at a time with AVX2, finding the
+ * same values as the scalar code
+ *
+ * @param[in,out] red - red values, replaced by hue
+ * @param[in,out] green - green values, replaced by saturation
+ * @param[in,out] blue - blue values, replaced by value
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns converted, a multiple of 8
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int toHSVRowAVX2(pixel* red, pixel* green, pixel* blue,
+    int cols)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i mask = _mm256_set1_epi32(255);
+    __m256i r, g, b, high, low, delta, sixths, hue, sat;
+    int j;
+
+    for (j = 0; j + 8 <= cols; j += 8)
+    {
+        r = loadWide(red + j);
+        g = loadWide(green + j);
+        b = loadWide(blue + j);
+        high = _mm256_max_epi32(r, _mm256_max_epi32(g, b));
+        low = _mm256_min_epi32(r, _mm256_min_epi32(g, b));
+        delta = _mm256_sub_epi32(high, low);
+        sixths = _mm256_mullo_epi32(delta, _mm256_set1_epi32(6));
+
+        // hue in sixths of the wheel, times delta, red tested last so it wins
+        hue = _mm256_add_epi32(_mm256_slli_epi32(delta, 2), _mm256_sub_epi32(r, g));
+        hue = _mm256_blendv_epi8(hue, _mm256_add_epi32(_mm256_slli_epi32(delta, 1),
+            _mm256_sub_epi32(b, r)), _mm256_cmpeq_epi32(high, g));
+        hue = _mm256_blendv_epi8(hue, _mm256_sub_epi32(g, b),
+            _mm256_cmpeq_epi32(high, r));
+        hue = _mm256_add_epi32(hue, _mm256_and_si256(sixths,
+            _mm256_cmpgt_epi32(zero, hue)));
+
+        // gray pixels have a zero numerator, so dividing by one gives zero
+        hue = divideWide(_mm256_add_epi32(_mm256_slli_epi32(hue, 8),
+            _mm256_mullo_epi32(delta, _mm256_set1_epi32(3))),
+            _mm256_max_epi32(sixths, one));
+        sat = divideWide(_mm256_add_epi32(_mm256_mullo_epi32(delta, mask),
+            _mm256_srli_epi32(high, 1)), _mm256_max_epi32(high, one));
+
+        storeWide(red + j, _mm256_and_si256(hue, mask));
+        storeWide(green + j, sat);
+        storeWide(blue + j, high);
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Divides 8 32 bit values below 65535 by 255, rounding down, without a
+ * division
+ *
+ * @param[in] num - numerators
+ *
+ * @returns returns the quotients
+ *
+ *****************************************************************************/
+TARGET_AVX2 static __m256i divide255(__m256i num)
+{
+    return _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(num,
+        _mm256_srli_epi32(num, 8)), _mm256_set1_epi32(1)), 8);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Picks one of six values for each of 8 pixels by its sector of the color
+ * wheel
+ *
+ * @param[in] inSector - masks of the pixels in sectors 1 to 5, [0] unused
+ * @param[in] choices - value to pick for each sector
+ *
+ * @returns returns the picked values
+ *
+ *****************************************************************************/
+TARGET_AVX2 static __m256i pickSector(const __m256i inSector[6],
+    const __m256i choices[6])
+{
+    __m256i picked = choices[0];
+
+    picked = _mm256_blendv_epi8(picked, choices[1], inSector[1]);
+    picked = _mm256_blendv_epi8(picked, choices[2], inSector[2]);
+    picked = _mm256_blendv_epi8(picked, choices[3], inSector[3]);
+    picked = _mm256_blendv_epi8(picked, choices[4], inSector[4]);
+    picked = _mm256_blendv_epi8(picked, choices[5], inSector[5]);
+
+    return picked;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from HSV to RGB 8 pixels at a time with AVX2, finding the
+ * same values as the scalar code
+ *
+ * @param[in,out] red - hue values, replaced by red
+ * @param[in,out] green - saturation values, replaced by green
+ * @param[in,out] blue - value values, replaced by blue
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns converted, a multiple of 8
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int fromHSVRowAVX2(pixel* red, pixel* green,
+    pixel* blue, int cols)
+{
+    const __m256i full = _mm256_set1_epi32(255);
+    const __m256i wide = _mm256_set1_epi32(255 * 256);
+    const __m256i wideHalf = _mm256_set1_epi32(255 * 128);
+    __m256i hue, sat, val, sector, frac, mix, p, q, t, inSector[6];
+    int j, k;
+
+    for (j = 0; j + 8 <= cols; j += 8)
+    {
+        hue = loadWide(red + j);
+        hue = _mm256_add_epi32(_mm256_slli_epi32(hue, 2), _mm256_slli_epi32(hue, 1));
+        sat = loadWide(green + j);
+        val = loadWide(blue + j);
+        sector = _mm256_srli_epi32(hue, 8);
+        frac = _mm256_and_si256(hue, full);
+        for (k = 1; k < 6; k++)
+        {
+            inSector[k] = _mm256_cmpeq_epi32(sector, _mm256_set1_epi32(k));
+        }
+
+        // the three levels each sector of the wheel mixes. sat * frac fits
+        // in 16 bits, and the divisions by 255 * 256 are a shift and then
+        // a division by 255.
+        p = divide255(_mm256_add_epi32(_mm256_mullo_epi32(val,
+            _mm256_sub_epi32(full, sat)), _mm256_set1_epi32(127)));
+        mix = _mm256_sub_epi32(wide, _mm256_mullo_epi16(sat, frac));
+        q = divide255(_mm256_srli_epi32(_mm256_add_epi32(
+            _mm256_mullo_epi32(val, mix), wideHalf), 8));
+        mix = _mm256_sub_epi32(wide, _mm256_mullo_epi16(sat,
+            _mm256_sub_epi32(_mm256_set1_epi32(256), frac)));
+        t = divide255(_mm256_srli_epi32(_mm256_add_epi32(
+            _mm256_mullo_epi32(val, mix), wideHalf), 8));
+
+        const __m256i reds[6] = { val, q, p, p, t, val };
+        const __m256i greens[6] = { t, val, val, q, p, p };
+        const __m256i blues[6] = { p, p, t, val, val, q };
+
+        storeWide(red + j, pickSector(inSector, reds));
+        storeWide(green + j, pickSector(inSector, greens));
+        storeWide(blue + j, pickSector(inSector, blues));
+    }
+
+    return j;
+}
+#endif
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from RGB to full range YCbCr (JPEG), as many pixels at a
+ * time as the SIMD level allows
+ *
+ * @param[in,out] red - red values, replaced by luma
+ * @param[in,out] green - green values, replaced by blue difference
+ * @param[in,out] blue - blue values, replaced by red difference
+ * @param[in] cols - columns in the row
+ * @param[in] level - SIMD instruction set to use
+ *
+ *****************************************************************************/
+static void toYCbCrRow(pixel* red, pixel* green, pixel* blue, int cols,
+    simdLevel level)
+{
+    int j = 0, r, g, b;
+
+#ifdef SIMD_X86
+    if (level == SIMD_AVX2)
+    {
+        j = toYCbCrRowAVX2(red, green, blue, cols);
+    }
+    if (level >= SIMD_SSE2)
+    {
+        j += toYCbCrRowSSE2(red + j, green + j, blue + j, cols - j);
+    }
+#endif
+    for (; j < cols; j++)
+    {
+        r = red[j];
+        g = green[j];
+        b = blue[j];
+        red[j] = fixedToPixel(Y_R * r + Y_G * g + Y_B * b);
+        green[j] = fixedToPixel((128 << YCC_SHIFT) - CB_R * r - CB_G * g
+            + CB_B * b);
+        blue[j] = fixedToPixel((128 << YCC_SHIFT) + CR_R * r - CR_G * g
+            - CR_B * b);
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts an image from RGB to full range YCbCr (JPEG), replacing the red,
+ * green and blue colorbands with luma, blue difference and red difference.
+ * The weights are fixed point with YCC_SHIFT fraction bits. The rows are
+ * split between threads.
+ *
+ * @param[in,out] img - image structure
+ *
+ *****************************************************************************/
+void rgbToYCbCr(image& img)
+{
+    simdLevel level = detectSimd();
+
+    if (img.green == nullptr) return;
+
+    parallelRows(img.rows, threadCount(img.rows), [&](int first, int last, int)
+    {
+        int i;
+
+        for (i = first; i < last; i++)
+        {
+            toYCbCrRow(img.redgray[i], img.green[i], img.blue[i], img.cols,
+                level);
+        }
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from full range YCbCr (JPEG) back to RGB, as many pixels
+ * at a time as the SIMD level allows
+ *
+ * @param[in,out] red - luma values, replaced by red
+ * @param[in,out] green - blue difference values, replaced by green
+ * @param[in,out] blue - red difference values, replaced by blue
+ * @param[in] cols - columns in the row
+ * @param[in] level - SIMD instruction set to use
+ *
+ *****************************************************************************/
+static void toRGBRow(pixel* red, pixel* green, pixel* blue, int cols,
+    simdLevel level)
+{
+    int j = 0, y, cb, cr;
+
+#ifdef SIMD_X86
+    if (level == SIMD_AVX2)
+    {
+        j = toRGBRowAVX2(red, green, blue, cols);
+    }
+    if (level >= SIMD_SSE2)
+    {
+        j += toRGBRowSSE2(red + j, green + j, blue + j, cols - j);
+    }
+#endif
+    for (; j < cols; j++)
+    {
+        y = red[j] * YCC_ONE;
+        cb = green[j] - 128;
+        cr = blue[j] - 128;
+        red[j] = fixedToPixel(y + R_CR * cr);
+        green[j] = fixedToPixel(y - G_CB * cb - G_CR * cr);
+        blue[j] = fixedToPixel(y + B_CB * cb);
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts an image from full range YCbCr (JPEG) back to RGB. The rows are
+ * split between threads.
+ *
+ * @param[in,out] img - image structure
+ *
+ *****************************************************************************/
+void yCbCrToRGB(image& img)
+{
+    simdLevel level = detectSimd();
+
+    if (img.green == nullptr) return;
+
+    parallelRows(img.rows, threadCount(img.rows), [&](int first, int last, int)
+    {
+        int i;
+
+        for (i = first; i < last; i++)
+        {
+            toRGBRow(img.redgray[i], img.green[i], img.blue[i], img.cols,
+                level);
+        }
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from RGB to HSV. Hue goes around the color wheel once
+ * over [0, 255], starting and ending at red.
+ *
+ * @param[in,out] red - red values, replaced by hue
+ * @param[in,out] green - green values, replaced by saturation
+ * @param[in,out] blue - blue values, replaced by value
+ * @param[in] cols - columns in the row
+ * @param[in] level - SIMD instruction set to use
+ *
+ *****************************************************************************/
+static void toHSVRow(pixel* red, pixel* green, pixel* blue, int cols,
+    simdLevel level)
+{
+    int j = 0, r, g, b, high, low, delta, hue;
+
+#ifdef SIMD_X86
+    if (level == SIMD_AVX2)
+    {
+        j = toHSVRowAVX2(red, green, blue, cols);
+    }
+#endif
+    for (; j < cols; j++)
+    {
+        r = red[j];
+        g = green[j];
+        b = blue[j];
+        high = max(r, max(g, b));
+        low = min(r, min(g, b));
+        delta = high - low;
+
+        // hue in sixths of the wheel, times delta
+        if (delta == 0)
+        {
+            hue = 0;
+        }
+        else if (high == r)
+        {
+            hue = g - b;
+        }
+        else if (high == g)
+        {
+            hue = 2 * delta + b - r;
+        }
+        else {
+            hue = 4 * delta + r - g;
+        }
+        if (hue < 0) hue += 6 * delta;
+
+        red[j] = delta == 0 ? 0 : ((hue * 256 + 3 * delta) / (6 * delta)) & 255;
+        green[j] = high == 0 ? 0 : (255 * delta + high / 2) / high;
+        blue[j] = high;
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts an image from RGB to HSV, replacing the red, green and blue
+ * colorbands with hue, saturation and value. Hue goes around the color
+ * wheel once over [0, 255], starting and ending at red. The rows are split
+ * between threads.
+ *
+ * @param[in,out] img - image structure
+ *
+ *****************************************************************************/
+void rgbToHSV(image& img)
+{
+    simdLevel level = detectSimd();
+
+    if (img.green == nullptr) return;
+
+    parallelRows(img.rows, threadCount(img.rows), [&](int first, int last, int)
+    {
+        int i;
+
+        for (i = first; i < last; i++)
+        {
+            toHSVRow(img.redgray[i], img.green[i], img.blue[i], img.cols,
+                level);
+        }
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row from HSV back to RGB
+ *
+ * @param[in,out] red - hue values, replaced by red
+ * @param[in,out] green - saturation values, replaced by green
+ * @param[in,out] blue - value values, replaced by blue
+ * @param[in] cols - columns in the row
+ * @param[in] level - SIMD instruction set to use
+ *
+ *****************************************************************************/
+static void fromHSVRow(pixel* red, pixel* green, pixel* blue, int cols,
+    simdLevel level)
+{
+    int j = 0, hue, sat, val, sector, frac, p, q, t;
+
+#ifdef SIMD_X86
+    if (level == SIMD_AVX2)
+    {
+        j = fromHSVRowAVX2(red, green, blue, cols);
+    }
+#endif
+    for (; j < cols; j++)
+    {
+        hue = red[j] * 6;
+        sat = green[j];
+        val = blue[j];
+        sector = hue >> 8;
+        frac = hue & 255;
+
+        // the three levels each sector of the wheel mixes
+        p = (val * (255 - sat) + 127) / 255;
+        q = (val * (255 * 256 - sat * frac) + 255 * 128) / (255 * 256);
+        t = (val * (255 * 256 - sat * (256 - frac)) + 255 * 128) / (255 * 256);
+
+        switch (sector)
+        {
+        case(0):
+            red[j] = val; green[j] = t; blue[j] = p;
+            break;
+        case(1):
+            red[j] = q; green[j] = val; blue[j] = p;
+            break;
+        case(2):
+            red[j] = p; green[j] = val; blue[j] = t;
+            break;
+        case(3):
+            red[j] = p; green[j] = q; blue[j] = val;
+            break;
+        case(4):
+            red[j] = t; green[j] = p; blue[j] = val;
+            break;
+        default:
+            red[j] = val; green[j] = p; blue[j] = q;
+            break;
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts an image from HSV back to RGB. The rows are split between
+ * threads.
+ *
+ * @param[in,out] img - image structure
+ *
+ *****************************************************************************/
+void hsvToRGB(image& img)
+{
+    simdLevel level = detectSimd();
+
+    if (img.green == nullptr) return;
+
+    parallelRows(img.rows, threadCount(img.rows), [&](int first, int last, int)
+    {
+        int i;
+
+        for (i = first; i < last; i++)
+        {
+            fromHSVRow(img.redgray[i], img.green[i], img.blue[i], img.cols,
+                level);
+        }
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts an image from one color space to another, going through RGB
+ *
+ * @param[in,out] img - image structure
+ * @param[in] from - color space the image is in
+ * @param[in] to - color space to convert to
+ *
+ *****************************************************************************/
+void convertColorSpace(image& img, colorSpace from, colorSpace to)
+{
+    if (from == to) return;
+
+    if (from == YCBCR_SPACE)
+    {
+        yCbCrToRGB(img);
+    }
+    else if (from == HSV_SPACE)
+    {
+        hsvToRGB(img);
+    }
+
+    if (to == YCBCR_SPACE)
+    {
+        rgbToYCbCr(img);
+    }
+    else if (to == HSV_SPACE)
+    {
+        rgbToHSV(img);
+    }
+}
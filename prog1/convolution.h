@@ -0,0 +1,317 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief Convolution with kernels whose coefficients are template
+ * parameters. The taps are summed by templates that unroll at compile time
+ * and leave out zero coefficients entirely. A kernel that is an outer
+ * product of a column and a row of integers is found at compile time and
+ * convolved as a vertical pass and a horizontal pass instead.
+ ****************************************************************************/
+
+#include "netPBM.h"
+
+#ifndef __CONVOLUTION__H__
+#define __CONVOLUTION__H__
+
+/**
+ * @brief A square convolution kernel, its coefficients listed a row at a time
+ */
+template <int width, int... taps>
+struct convKernel
+{
+    static_assert(width % 2 == 1 && sizeof...(taps) == width * width,
+        "a kernel needs an odd width and width * width coefficients");
+
+    static const int size = width;       /**< Rows and columns in the kernel */
+    static const int radius = width / 2; /**< Rows and columns around the center */
+
+    /**
+     * @brief Coefficient k, counting a row at a time
+     */
+    static constexpr int tap(int k)
+    {
+        const int coefficient[] = { taps... };
+        return coefficient[k];
+    }
+
+    /**
+     * @brief Coefficient at a row and column
+     */
+    static constexpr int at(int i, int j)
+    {
+        return tap(i * width + j);
+    }
+
+    /**
+     * @brief Greatest common divisor of a row, to take out of the row factor
+     */
+    static constexpr int rowDivisor(int i)
+    {
+        int a = 0, b = 0, t = 0, j = 0;
+
+        for (j = 0; j < width; j++)
+        {
+            b = at(i, j) < 0 ? -at(i, j) : at(i, j);
+            while (b != 0)
+            {
+                t = a % b;
+                a = b;
+                b = t;
+            }
+        }
+        return a == 0 ? 1 : a;
+    }
+
+    /**
+     * @brief First row with a nonzero coefficient, width if there is none
+     */
+    static constexpr int pivotRow()
+    {
+        int i = 0, j = 0;
+
+        for (i = 0; i < width; i++)
+        {
+            for (j = 0; j < width; j++)
+            {
+                if (at(i, j) != 0) return i;
+            }
+        }
+        return width;
+    }
+
+    /**
+     * @brief First column with a nonzero coefficient in the pivot row
+     */
+    static constexpr int pivotCol()
+    {
+        int j = 0;
+
+        for (j = 0; j < width; j++)
+        {
+            if (at(pivotRow(), j) != 0) return j;
+        }
+        return width;
+    }
+
+    /**
+     * @brief Coefficient j of the row factor of a separable kernel
+     */
+    static constexpr int rowTap(int j)
+    {
+        return at(pivotRow(), j) / rowDivisor(pivotRow());
+    }
+
+    /**
+     * @brief Coefficient i of the column factor of a separable kernel
+     */
+    static constexpr int colTap(int i)
+    {
+        return at(i, pivotCol()) / rowTap(pivotCol());
+    }
+
+    /**
+     * @brief True if the kernel is exactly the column factor times the row
+     * factor
+     */
+    static constexpr bool separable()
+    {
+        int i = 0, j = 0;
+
+        if (pivotRow() == width) return false;
+        for (i = 0; i < width; i++)
+        {
+            for (j = 0; j < width; j++)
+            {
+                if (colTap(i) * rowTap(j) != at(i, j)) return false;
+            }
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief A color value times a coefficient, a zero coefficient reads nothing
+ */
+template <int coefficient, class T>
+struct weighTap
+{
+    static int apply(const T* value) { return coefficient * *value; }
+};
+
+/**
+ * @brief A zero coefficient, left out of the sum
+ */
+template <class T>
+struct weighTap<0, T>
+{
+    static int apply(const T*) { return 0; }
+};
+
+/**
+ * @brief Sum of taps 0 to k of a kernel over a window of rows
+ */
+template <class K, int k>
+struct tapSum
+{
+    static int apply(const pixel* const* window, int j)
+    {
+        return tapSum<K, k - 1>::apply(window, j)
+            + weighTap<K::tap(k), pixel>::apply(window[k / K::size] + j
+                + k % K::size - K::radius);
+    }
+};
+
+/**
+ * @brief Sum of no taps
+ */
+template <class K>
+struct tapSum<K, -1>
+{
+    static int apply(const pixel* const*, int) { return 0; }
+};
+
+/**
+ * @brief Sum of taps 0 to k of the column factor of a kernel down a window
+ * of rows
+ */
+template <class K, int k>
+struct colTapSum
+{
+    static int apply(const pixel* const* window, int j)
+    {
+        return colTapSum<K, k - 1>::apply(window, j)
+            + weighTap<K::colTap(k), pixel>::apply(window[k] + j);
+    }
+};
+
+/**
+ * @brief Sum of no column taps
+ */
+template <class K>
+struct colTapSum<K, -1>
+{
+    static int apply(const pixel* const*, int) { return 0; }
+};
+
+/**
+ * @brief Sum of taps 0 to k of the row factor of a kernel along a row of
+ * column sums
+ */
+template <class K, int k>
+struct rowTapSum
+{
+    static int apply(const int* sums, int j)
+    {
+        return rowTapSum<K, k - 1>::apply(sums, j)
+            + weighTap<K::rowTap(k), int>::apply(sums + j + k - K::radius);
+    }
+};
+
+/**
+ * @brief Sum of no row taps
+ */
+template <class K>
+struct rowTapSum<K, -1>
+{
+    static int apply(const int*, int) { return 0; }
+};
+
+/**
+ * @brief Convolves a row with a kernel that is not separable, every tap at
+ * every pixel
+ */
+template <class K, bool separable = K::separable()>
+struct convolveKernel
+{
+    static void row(const pixel* const* window, int first, int last, int* out,
+        int*)
+    {
+        int j;
+
+        for (j = first; j < last; j++)
+        {
+            out[j - first] = tapSum<K, K::size * K::size - 1>::apply(window, j);
+        }
+    }
+};
+
+/**
+ * @brief Convolves a row with a separable kernel, summing down the columns
+ * first and then along the column sums
+ */
+template <class K>
+struct convolveKernel<K, true>
+{
+    static void row(const pixel* const* window, int first, int last, int* out,
+        int* sums)
+    {
+        int j;
+
+        // sums[0] is the column radius left of first
+        for (j = first - K::radius; j < last + K::radius; j++)
+        {
+            sums[j - first + K::radius] = colTapSum<K, K::size - 1>::apply(window, j);
+        }
+        for (j = 0; j < last - first; j++)
+        {
+            out[j] = rowTapSum<K, K::size - 1>::apply(sums, j + K::radius);
+        }
+    }
+};
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Convolves part of one row of a colorband with a kernel. The rows and
+ * columns within radius of the part must be readable.
+ *
+ * @param[in] colorband - the colorband
+ * @param[in] i - row to convolve
+ * @param[in] first - first column to convolve
+ * @param[in] last - one past the last column to convolve
+ * @param[out] out - last - first sums, starting at column first
+ * @param[out] sums - last - first + 2 * radius ints of scratch space for a
+ * separable kernel
+ *
+ *****************************************************************************/
+template <class K>
+void convolveRow(pixel** colorband, int i, int first, int last, int* out,
+    int* sums)
+{
+    convolveKernel<K>::row(colorband + i - K::radius, first, last, out, sums);
+}
+
+/**
+ * @brief Sharpening kernel, five times the pixel less its four neighbors
+ */
+typedef convKernel<3,
+     0, -1,  0,
+    -1,  5, -1,
+     0, -1,  0> sharpenKernel;
+
+/**
+ * @brief Box kernel, the sum of the 3x3 box around the pixel
+ */
+typedef convKernel<3,
+    1, 1, 1,
+    1, 1, 1,
+    1, 1, 1> boxKernel;
+
+/**
+ * @brief Sobel kernel for the change in intensity from right to left
+ */
+typedef convKernel<3,
+    1, 0, -1,
+    2, 0, -2,
+    1, 0, -1> sobelXKernel;
+
+/**
+ * @brief Sobel kernel for the change in intensity from bottom to top
+ */
+typedef convKernel<3,
+     1,  2,  1,
+     0,  0,  0,
+    -1, -2, -1> sobelYKernel;
+
+#endif
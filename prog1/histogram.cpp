@@ -0,0 +1,288 @@
+/** **************************************************************************
+ * @file
+ * 
+ * @brief The source code for counting how often each color value appears in
+ * an image
+ ****************************************************************************/
+
+#include "netPBM.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets every count in a band counter to zero
+ *
+ * @param[out] counter - the band counter
+ *
+ *****************************************************************************/
+void clearCounter(bandCounter& counter)
+{
+    memset(counter.bins, 0, sizeof(counter.bins));
+    memset(counter.totals, 0, sizeof(counter.totals));
+    counter.pending = 0;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Moves the counts of a band counter's sub-histograms into its totals and
+ * sets the sub-histograms to zero
+ *
+ * @param[in,out] counter - the band counter
+ *
+ *****************************************************************************/
+static void flushCounter(bandCounter& counter)
+{
+    int lane, value;
+
+    for (lane = 0; lane < HIST_LANES; lane++)
+    {
+        for (value = 0; value < 256; value++)
+        {
+            counter.totals[value] += counter.bins[lane][value];
+        }
+    }
+    memset(counter.bins, 0, sizeof(counter.bins));
+    counter.pending = 0;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Counts the color values in a row. Sixteen values are loaded at once and
+ * spread over the HIST_LANES sub-histograms, so runs of the same value do
+ * not wait on each other's increments. The 32 bit sub-histograms keep the
+ * eight of them in the same 8 KB as four 64 bit ones, and are flushed
+ * before a row could overflow them.
+ *
+ * @param[in,out] counter - the band counter to add to
+ * @param[in] row - the row of color values
+ * @param[in] cols - columns in the row
+ *
+ *****************************************************************************/
+void countRow(bandCounter& counter, const pixel* row, int cols)
+{
+    uint32_t* bins0 = counter.bins[0];
+    uint32_t* bins1 = counter.bins[1];
+    uint32_t* bins2 = counter.bins[2];
+    uint32_t* bins3 = counter.bins[3];
+    uint32_t* bins4 = counter.bins[4];
+    uint32_t* bins5 = counter.bins[5];
+    uint32_t* bins6 = counter.bins[6];
+    uint32_t* bins7 = counter.bins[7];
+    uint64_t word, next;
+    int j;
+
+    if (counter.pending + cols > UINT32_MAX) flushCounter(counter);
+    counter.pending += cols;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        memcpy(&word, row + j, sizeof(word));
+        memcpy(&next, row + j + 8, sizeof(next));
+        bins0[word & 0xFF]++;
+        bins1[(word >> 8) & 0xFF]++;
+        bins2[(word >> 16) & 0xFF]++;
+        bins3[(word >> 24) & 0xFF]++;
+        bins4[(word >> 32) & 0xFF]++;
+        bins5[(word >> 40) & 0xFF]++;
+        bins6[(word >> 48) & 0xFF]++;
+        bins7[word >> 56]++;
+        bins0[next & 0xFF]++;
+        bins1[(next >> 8) & 0xFF]++;
+        bins2[(next >> 16) & 0xFF]++;
+        bins3[(next >> 24) & 0xFF]++;
+        bins4[(next >> 32) & 0xFF]++;
+        bins5[(next >> 40) & 0xFF]++;
+        bins6[(next >> 48) & 0xFF]++;
+        bins7[next >> 56]++;
+    }
+    for (; j < cols; j++)
+    {
+        bins0[row[j]]++;
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Adds the counts of a band counter to one colorband of a histogram
+ *
+ * @param[in] counter - the band counter
+ * @param[in,out] hist - the histogram to add to
+ * @param[in] channel - colorband of the histogram, 0 red/gray, 1 green,
+ * 2 blue
+ *
+ *****************************************************************************/
+void addCounter(const bandCounter& counter, histogram& hist, int channel)
+{
+    int lane, value;
+
+    for (value = 0; value < 256; value++)
+    {
+        hist.count[channel][value] += counter.totals[value];
+    }
+    for (lane = 0; lane < HIST_LANES; lane++)
+    {
+        for (value = 0; value < 256; value++)
+        {
+            hist.count[channel][value] += counter.bins[lane][value];
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a histogram with every count zero
+ *
+ * @param[in] channels - number of colorbands it counts
+ * @param[in] pixels - number of pixels counted in each colorband
+ *
+ * @returns returns the histogram
+ *
+ *****************************************************************************/
+histogram emptyHistogram(int channels, size_t pixels)
+{
+    histogram hist;
+
+    hist.channels = channels;
+    hist.pixels = pixels;
+    memset(hist.count, 0, sizeof(hist.count));
+
+    return hist;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Counts how often each value appears in each colorband of an image. The
+ * rows are split between threads, each with its own band counters, and the
+ * counters are added together at the end.
+ *
+ * @param[in] img - image structure
+ *
+ * @returns returns the histogram
+ *
+ *****************************************************************************/
+histogram imageHistogram(image& img)
+{
+    return imageHistogram(img, imageChannels(img), [](int) {});
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Counts how often each value appears in the first colorbands of an image,
+ * doing some work on each row just before it is counted so the row is
+ * counted while it is still in cache. The rows are split between threads,
+ * each with its own band counters, and the counters are added together at
+ * the end.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] channels - number of colorbands to count, starting at red/gray
+ * @param[in] prepare - work to do on a row, given the row
+ *
+ * @returns returns the histogram
+ *
+ *****************************************************************************/
+histogram imageHistogram(image& img, int channels,
+    const function<void(int)>& prepare)
+{
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    int threads = threadCount(img.rows);
+    int t, c;
+    vector<bandCounter> counters(threads * channels);
+    histogram hist = emptyHistogram(channels, (size_t)img.rows * img.cols);
+
+    parallelRows(img.rows, threads, [&](int first, int last, int t)
+    {
+        int i, c;
+
+        for (c = 0; c < channels; c++)
+        {
+            clearCounter(counters[t * channels + c]);
+        }
+        for (i = first; i < last; i++)
+        {
+            prepare(i);
+            for (c = 0; c < channels; c++)
+            {
+                countRow(counters[t * channels + c], bands[c][i], img.cols);
+            }
+        }
+    });
+
+    for (t = 0; t < threads; t++)
+    {
+        for (c = 0; c < channels; c++)
+        {
+            addCounter(counters[t * channels + c], hist, c);
+        }
+    }
+
+    return hist;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Computes the cumulative distribution of a colorband, the number of pixels
+ * with each value or less
+ *
+ * @param[in] hist - the histogram
+ * @param[in] channel - colorband of the histogram
+ * @param[out] cdf - count of pixels with each value or less
+ *
+ *****************************************************************************/
+void cumulativeCounts(const histogram& hist, int channel, size_t cdf[256])
+{
+    size_t sum = 0;
+    int value;
+
+    for (value = 0; value < 256; value++)
+    {
+        sum += hist.count[channel][value];
+        cdf[value] = sum;
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the smallest value that at least a percent of the pixels in a
+ * colorband are less than or equal to. The 0th percentile is the smallest
+ * value in the colorband and the 100th is the largest.
+ *
+ * @param[in] hist - the histogram
+ * @param[in] channel - colorband of the histogram
+ * @param[in] percent - percent of pixels, [0, 100]
+ *
+ * @returns returns the value at the percentile
+ *
+ *****************************************************************************/
+int histogramPercentile(const histogram& hist, int channel, double percent)
+{
+    size_t cdf[256], target;
+    int value;
+
+    cumulativeCounts(hist, channel, cdf);
+    target = (size_t)ceil(min(max(percent, 0.0), 100.0) / 100.0 * hist.pixels);
+    target = max(target, (size_t)1);
+
+    for (value = 0; value < 255; value++)
+    {
+        if (cdf[value] >= target) break;
+    }
+
+    return value;
+}
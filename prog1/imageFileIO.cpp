@@ -6,6 +6,7 @@
  ****************************************************************************/
 
 #include "netPBM.h"
+#include "pixelExpr.h"
 
 /** ***************************************************************************
  * @author Adam Kraus
@@ -154,7 +155,8 @@ void readASCII(ifstream& file, image& img)
  * @author Adam Kraus
  *
  * @par Description:
- * Reads in Binary image data
+ * Reads in Binary image data a row at a time, splitting each row into the
+ * colorbands
  *
  * @param[in] file - reference to ifstream
  * @param[out] img - image structure
@@ -162,15 +164,68 @@ void readASCII(ifstream& file, image& img)
  *****************************************************************************/
 void readBIN(ifstream& file, image& img)
 {
+    vector<pixel> buffer(3 * (size_t)img.cols);
+    const pixel* in;
     int i, j;
 
     for (i = 0; i < img.rows; i++)
     {
-        for (j = 0; j < img.cols; j++)
+        file.read((char*)buffer.data(), buffer.size());
+        in = buffer.data();
+        for (j = 0; j < img.cols; j++, in += 3)
+        {
+            img.redgray[i][j] = in[0];
+            img.green[i][j] = in[1];
+            img.blue[i][j] = in[2];
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Reads in Binary image data and applies a chain of point operations while
+ * splitting each row into the colorbands, so the image is never swept
+ * again to alter it. A chain that converts to grayscale only fills the
+ * first colorband.
+ *
+ * @param[in] file - reference to ifstream
+ * @param[out] img - image structure, with only the red/gray colorband if
+ * the chain converts to grayscale
+ * @param[in] chain - chain of point operations
+ *
+ *****************************************************************************/
+void readBINChain(ifstream& file, image& img, const pointChain& chain)
+{
+    vector<pixel> buffer(3 * (size_t)img.cols);
+    pointTable both = composeTables(chain.before, chain.after);
+    const pixel* before = chain.before.value;
+    const pixel* after = chain.after.value;
+    const pixel* in;
+    pixel* gray;
+    int i, j;
+
+    for (i = 0; i < img.rows; i++)
+    {
+        file.read((char*)buffer.data(), buffer.size());
+        in = buffer.data();
+        if (chain.gray)
         {
-            file.read((char*) &img.redgray[i][j], sizeof(pixel));
-            file.read((char*) &img.green[i][j], sizeof(pixel));
-            file.read((char*) &img.blue[i][j], sizeof(pixel));
+            gray = img.redgray[i];
+            for (j = 0; j < img.cols; j++, in += 3)
+            {
+                gray[j] = after[grayValue(before[in[0]], before[in[1]],
+                    before[in[2]])];
+            }
+        }
+        else {
+            for (j = 0; j < img.cols; j++, in += 3)
+            {
+                img.redgray[i][j] = both.value[in[0]];
+                img.green[i][j] = both.value[in[1]];
+                img.blue[i][j] = both.value[in[2]];
+            }
         }
     }
 }
@@ -207,38 +262,116 @@ void writeHeader(ofstream& file, string magicNum, vector<string>& comments, int
  * @author Adam Kraus
  *
  * @par Description:
- * Writes out image data in ASCII
+ * Puts a row of the colorbands of an image back together, one color value
+ * of each colorband per pixel. The number of colorbands is known when it
+ * is compiled, so the loop over them is unrolled.
  *
- * @param[in] file - reference to ofstream
- * @param[in] img - image structure
+ * @param[in] bands - the colorbands, red/gray first
+ * @param[in] i - row to put together
+ * @param[in] cols - columns in the image
+ * @param[out] out - channels * cols color values
  *
  *****************************************************************************/
-void writeASCII(ofstream& file, image& img)
+template <int channels>
+static void interleaveRow(pixel** const bands[], int i, int cols, pixel* out)
 {
-    int i, j, value;
+    int j, k;
 
-    for (i = 0; i < img.rows; i++)
+    for (j = 0; j < cols; j++)
     {
-        for (j = 0; j < img.cols; j++)
+        for (k = 0; k < channels; k++)
         {
-            if (img.redgray != nullptr)
-            {
-                value = img.redgray[i][j];
-                file << value << endl;
-            }
+            *out++ = bands[k][i][j];
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Copies a row of a grayscale image, which is already in output order
+ *
+ * @param[in] bands - the gray colorband
+ * @param[in] i - row to copy
+ * @param[in] cols - columns in the image
+ * @param[out] out - cols color values
+ *
+ *****************************************************************************/
+template <>
+void interleaveRow<1>(pixel** const bands[], int i, int cols, pixel* out)
+{
+    memcpy(out, bands[0][i], cols);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Writes out the colorbands of an image in ASCII, one color value per line
+ * and one write per row
+ *
+ * @param[in] file - reference to ofstream
+ * @param[in] bands - the colorbands, red/gray first
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ *
+ *****************************************************************************/
+template <int channels>
+static void writeASCIIBands(ofstream& file, pixel** const bands[], int rows,
+    int cols)
+{
+    vector<pixel> values((size_t)channels * cols);
+    vector<char> text(4 * values.size());
+    char* out;
+    size_t k;
+    int i, value;
 
-            if (img.green != nullptr)
+    for (i = 0; i < rows; i++)
+    {
+        interleaveRow<channels>(bands, i, cols, values.data());
+        out = text.data();
+        for (k = 0; k < values.size(); k++)
+        {
+            value = values[k];
+            if (value >= 100)
             {
-                value = img.green[i][j];
-                file << value << endl;
+                *out++ = '0' + value / 100;
             }
-
-            if (img.blue != nullptr)
+            if (value >= 10)
             {
-                value = img.blue[i][j];
-                file << value << endl;
+                *out++ = '0' + value / 10 % 10;
             }
+            *out++ = '0' + value % 10;
+            *out++ = '\n';
         }
+        file.write(text.data(), out - text.data());
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Writes out the colorbands of an image in Binary, one write per row
+ *
+ * @param[in] file - reference to ofstream
+ * @param[in] bands - the colorbands, red/gray first
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ *
+ *****************************************************************************/
+template <int channels>
+static void writeBINBands(ofstream& file, pixel** const bands[], int rows,
+    int cols)
+{
+    vector<pixel> buffer((size_t)channels * cols);
+    int i;
+
+    for (i = 0; i < rows; i++)
+    {
+        interleaveRow<channels>(bands, i, cols, buffer.data());
+        file.write((char*)buffer.data(), buffer.size());
     }
 }
 
@@ -246,34 +379,46 @@ void writeASCII(ofstream& file, image& img)
  * @author Adam Kraus
  *
  * @par Description:
- * Writes out image data in Binary
+ * Writes out image data in ASCII, choosing the gray or color writer once
+ * for the whole image
  *
  * @param[in] file - reference to ofstream
  * @param[in] img - image structure
  *
  *****************************************************************************/
-void writeBIN(ofstream& file, image& img)
+void writeASCII(ofstream& file, image& img)
 {
-    int i, j;
+    pixel** const bands[3] = { img.redgray, img.green, img.blue };
 
-    for (i = 0; i < img.rows; i++)
+    if (imageChannels(img) == 1)
     {
-        for (j = 0; j < img.cols; j++)
-        {
-            if (img.redgray != nullptr)
-            {
-                file.write((char*)&img.redgray[i][j], sizeof(pixel));
-            }
-            
-            if (img.green != nullptr)
-            {
-                file.write((char*)&img.green[i][j], sizeof(pixel));
-            }
+        writeASCIIBands<1>(file, bands, img.rows, img.cols);
+    }
+    else {
+        writeASCIIBands<3>(file, bands, img.rows, img.cols);
+    }
+}
 
-            if (img.blue != nullptr)
-            {
-                file.write((char*)&img.blue[i][j], sizeof(pixel));
-            }
-        }
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Writes out image data in Binary, choosing the gray or color writer once
+ * for the whole image
+ *
+ * @param[in] file - reference to ofstream
+ * @param[in] img - image structure
+ *
+ *****************************************************************************/
+void writeBIN(ofstream& file, image& img)
+{
+    pixel** const bands[3] = { img.redgray, img.green, img.blue };
+
+    if (imageChannels(img) == 1)
+    {
+        writeBINBands<1>(file, bands, img.rows, img.cols);
+    }
+    else {
+        writeBINBands<3>(file, bands, img.rows, img.cols);
     }
-}
\ No newline at end of file
+}
@@ -5,6 +5,8 @@
  ****************************************************************************/
 
 #include "netPBM.h"
+#include "pixelExpr.h"
+#include "convolution.h"
 
 /** ***************************************************************************
  * @author Adam Kraus
@@ -17,204 +19,1211 @@
  *****************************************************************************/
 void imageNegate(image& img)
 {
-    int i, j;
+    negateBand(img.redgray, img.rows, img.cols);
+    negateBand(img.green, img.rows, img.cols);
+    negateBand(img.blue, img.rows, img.cols);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Brighten image color values
+ *
+ * @param[in,out] img - image structure
+ * @param[in] value - value to be added to color values
+ *
+ *****************************************************************************/
+void imageBrighten(image& img, int value)
+{
+    brightenBand(img.redgray, img.rows, img.cols, value);
+    brightenBand(img.green, img.rows, img.cols, value);
+    brightenBand(img.blue, img.rows, img.cols, value);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sharpens image by convolving it with sharpenKernel, a tile at a time.
+ * The edge of the image is treated by the border mode.
+ *
+ * @param[in,out] img - image structure
+ *
+ *****************************************************************************/
+void imageSharpen(image& img)
+{
+    tileStencil(img, 1, [](pixel** in, pixel** out, int rows, int cols)
+    {
+        vector<int> sums(cols), scratch(cols + 2);
+        int i, j;
+
+        for (i = 0; i < rows; i++)
+        {
+            convolveRow<sharpenKernel>(in, i, 0, cols, sums.data(),
+                scratch.data());
+            for (j = 0; j < cols; j++)
+            {
+                out[i][j] = cropNum(sums[j]);
+            }
+        }
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Smooths image by averaging the (2 * radius + 1) squared box around each
+ * pixel, a tile at a time. The box is summed as a running sum of column
+ * sums, so a pixel costs the same whatever the radius: each step down adds
+ * the new row to the column sums and takes the old one out, and each step
+ * right adds a column sum and takes one out. The average is found by
+ * multiplying with a fixed point reciprocal of the box size. The edge of
+ * the image is treated by the border mode.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] radius - radius of the box, 1 for a 3x3 box, up to MAX_RADIUS
+ *
+ *****************************************************************************/
+void imageSmooth(image& img, int radius)
+{
+    int width = 2 * radius + 1;
+    uint64_t reciprocal = ((uint64_t)1 << BOX_SHIFT) / (width * width) + 1;
+
+    tileStencil(img, radius, [&](pixel** in, pixel** out, int rows, int cols)
+    {
+        // colSum[k] is the sum of column k - radius
+        vector<uint32_t> colSum(cols + 2 * radius, 0);
+        uint32_t sum;
+        int i, j, k;
+
+        for (k = -radius; k < radius; k++)
+        {
+            for (j = 0; j < cols + 2 * radius; j++)
+            {
+                colSum[j] += in[k][j - radius];
+            }
+        }
+
+        for (i = 0; i < rows; i++)
+        {
+            // slide the column sums down to rows i - radius to i + radius
+            for (j = 0; j < cols + 2 * radius; j++)
+            {
+                colSum[j] += in[i + radius][j - radius];
+            }
+
+            sum = 0;
+            for (j = 0; j < width - 1; j++)
+            {
+                sum += colSum[j];
+            }
+            for (j = 0; j < cols; j++)
+            {
+                sum += colSum[j + 2 * radius];
+                out[i][j] = (pixel)((sum * reciprocal) >> BOX_SHIFT);
+                sum -= colSum[j];
+            }
+
+            for (j = 0; j < cols + 2 * radius; j++)
+            {
+                colSum[j] -= in[i - radius][j - radius];
+            }
+        }
+    });
+}
+
+/**
+ * @brief Coefficients of a recursive Gaussian filter, the sum of a causal
+ * filter run forward along a line and an anticausal one run backward
+ */
+struct gaussFilter
+{
+    double causal[4];      /**< Weights of the input at n, n - 1, n - 2 and n - 3 */
+    double anticausal[4];  /**< Weights of the input at n + 1 to n + 4 */
+    double feedback[4];    /**< Weights of the last four outputs, subtracted */
+    double causalGain;     /**< Output of the causal filter for an input of 1 */
+    double anticausalGain; /**< Output of the anticausal filter for an input of 1 */
+};
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the coefficients of Deriche's fourth order recursive filter for a
+ * Gaussian. One side of the Gaussian is fit by two damped cosines, each a
+ * pair of poles, so it is a ratio of polynomials in the delay. The causal
+ * filter is that ratio and the anticausal filter is its mirror image
+ * without the center tap. They are scaled so the whole filter sums to 1.
+ *
+ * @param[in] sigma - standard deviation, in [MIN_SIGMA, MAX_SIGMA]
+ *
+ * @returns returns the coefficients
+ *
+ *****************************************************************************/
+static gaussFilter gaussCoefficients(double sigma)
+{
+    // weights, frequencies and decays of the two damped cosines
+    const double cosWeight[2] = { 1.68, -0.6803 };
+    const double sinWeight[2] = { 3.735, -0.2598 };
+    const double frequency[2] = { 0.6318, 1.997 };
+    const double decay[2] = { 1.783, 1.723 };
+    double num[2][2], den[2][3], n[4], d[5], r, w, total;
+    gaussFilter filter;
+    int k;
+
+    for (k = 0; k < 2; k++)
+    {
+        r = exp(-decay[k] / sigma);
+        w = frequency[k] / sigma;
+        num[k][0] = cosWeight[k];
+        num[k][1] = r * (sinWeight[k] * sin(w) - cosWeight[k] * cos(w));
+        den[k][0] = 1;
+        den[k][1] = -2 * r * cos(w);
+        den[k][2] = r * r;
+    }
+
+    // put the two over a common denominator
+    n[0] = num[0][0] + num[1][0];
+    n[1] = num[0][1] + num[0][0] * den[1][1] + num[1][1] + num[1][0] * den[0][1];
+    n[2] = num[0][1] * den[1][1] + num[0][0] * den[1][2]
+        + num[1][1] * den[0][1] + num[1][0] * den[0][2];
+    n[3] = num[0][1] * den[1][2] + num[1][1] * den[0][2];
+    d[0] = 1;
+    d[1] = den[0][1] + den[1][1];
+    d[2] = den[0][2] + den[0][1] * den[1][1] + den[1][2];
+    d[3] = den[0][2] * den[1][1] + den[0][1] * den[1][2];
+    d[4] = den[0][2] * den[1][2];
+
+    // both sides less the center, counted twice, sum to 1
+    total = 2 * (n[0] + n[1] + n[2] + n[3]) / (d[0] + d[1] + d[2] + d[3] + d[4])
+        - n[0];
+    for (k = 0; k < 4; k++)
+    {
+        filter.causal[k] = n[k] / total;
+        filter.anticausal[k] = ((k < 3 ? n[k + 1] : 0) - n[0] * d[k + 1]) / total;
+        filter.feedback[k] = d[k + 1];
+    }
+    filter.causalGain = (n[0] + n[1] + n[2] + n[3]) / total
+        / (d[0] + d[1] + d[2] + d[3] + d[4]);
+    filter.anticausalGain = 1 - filter.causalGain;
+
+    return filter;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Blurs a line, running the causal filter forward and the anticausal one
+ * backward and adding them. The values past each end are taken to repeat
+ * the end value, which starts each filter at its output for that value.
+ *
+ * @param[in] line - values of the line, with the end value repeated four
+ * times past each end
+ * @param[out] out - blurred values
+ * @param[in] n - number of values
+ * @param[in] filter - coefficients of the filter
+ *
+ *****************************************************************************/
+static void gaussLine(const double* line, double* out, int n,
+    const gaussFilter& filter)
+{
+    const double* a = filter.causal;
+    const double* b = filter.anticausal;
+    const double* f = filter.feedback;
+    double y1, y2, y3, y4, y;
+    int j;
+
+    y1 = y2 = y3 = y4 = line[0] * filter.causalGain;
+    for (j = 0; j < n; j++)
+    {
+        y = a[0] * line[j] + a[1] * line[j - 1] + a[2] * line[j - 2]
+            + a[3] * line[j - 3] - f[0] * y1 - f[1] * y2 - f[2] * y3 - f[3] * y4;
+        y4 = y3;
+        y3 = y2;
+        y2 = y1;
+        y1 = out[j] = y;
+    }
+
+    y1 = y2 = y3 = y4 = line[n - 1] * filter.anticausalGain;
+    for (j = n - 1; j >= 0; j--)
+    {
+        y = b[0] * line[j + 1] + b[1] * line[j + 2] + b[2] * line[j + 3]
+            + b[3] * line[j + 4] - f[0] * y1 - f[1] * y2 - f[2] * y3 - f[3] * y4;
+        y4 = y3;
+        y3 = y2;
+        y2 = y1;
+        y1 = y;
+        out[j] += y;
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Blurs an image with a Gaussian of any standard deviation at the same
+ * cost per pixel, using Deriche's recursive filter. Each colorband is
+ * filtered along its rows into fixed point values, then down its columns
+ * back into color values. The vertical pass filters GAUSS_STRIP columns at
+ * once, a row at a time, so its loops run across the columns and are
+ * vectorized. The edge pixels of the image are taken to repeat past it,
+ * whatever the border mode.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] sigma - standard deviation, in [MIN_SIGMA, MAX_SIGMA]
+ *
+ *****************************************************************************/
+void imageGaussian(image& img, double sigma)
+{
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    const gaussFilter filter = gaussCoefficients(sigma);
+    int rows = img.rows, cols = img.cols, c;
+    int strips = (cols + GAUSS_STRIP - 1) / GAUSS_STRIP;
+    int** fixed = alloc2DInt(rows, cols);
+    pixel** band;
+
+    for (c = 0; c < 3; c++)
+    {
+        band = bands[c];
+        if (band == nullptr) continue;
+
+        // filter along the rows
+        parallelRows(rows, threadCount(rows), [&](int first, int last, int)
+        {
+            vector<double> line(cols + 8), out(cols);
+            int i, j;
+
+            for (i = first; i < last; i++)
+            {
+                for (j = -4; j < cols + 4; j++)
+                {
+                    line[j + 4] = band[i][min(max(j, 0), cols - 1)];
+                }
+                gaussLine(&line[4], out.data(), cols, filter);
+                for (j = 0; j < cols; j++)
+                {
+                    fixed[i][j] = (int)(out[j] * (1 << GAUSS_SHIFT) + 0.5);
+                }
+            }
+        });
+
+        // filter down strips of columns
+        parallelRows(strips, min(threadCount(rows), strips),
+            [&](int first, int last, int)
+        {
+            const double* a = filter.causal;
+            const double* b = filter.anticausal;
+            const double* f = filter.feedback;
+            const double scale = 1.0 / (1 << GAUSS_SHIFT);
+            vector<double> causal((size_t)rows * GAUSS_STRIP);
+            vector<double> state(5 * GAUSS_STRIP), start(GAUSS_STRIP);
+            double* y[5];
+            double* out;
+            const int* x[4];
+            pixel* to;
+            int s, i, j, k, j0, width, value;
+
+            for (s = first; s < last; s++)
+            {
+                j0 = s * GAUSS_STRIP;
+                width = min(GAUSS_STRIP, cols - j0);
+
+                // causal filter down the strip, y[k] is output row i - k
+                for (j = 0; j < width; j++)
+                {
+                    start[j] = fixed[0][j0 + j] * scale * filter.causalGain;
+                }
+                y[1] = y[2] = y[3] = y[4] = start.data();
+                for (i = 0; i < rows; i++)
+                {
+                    out = &causal[(size_t)i * GAUSS_STRIP];
+                    for (k = 0; k < 4; k++)
+                    {
+                        x[k] = fixed[max(i - k, 0)] + j0;
+                    }
+                    for (j = 0; j < width; j++)
+                    {
+                        out[j] = scale * (a[0] * x[0][j] + a[1] * x[1][j]
+                            + a[2] * x[2][j] + a[3] * x[3][j])
+                            - f[0] * y[1][j] - f[1] * y[2][j]
+                            - f[2] * y[3][j] - f[3] * y[4][j];
+                    }
+                    y[4] = y[3];
+                    y[3] = y[2];
+                    y[2] = y[1];
+                    y[1] = out;
+                }
+
+                // anticausal filter up the strip, added to the causal one,
+                // y[k] is output row i + k, the five rows take turns
+                for (k = 1; k < 5; k++)
+                {
+                    for (j = 0; j < width; j++)
+                    {
+                        state[k * GAUSS_STRIP + j] = fixed[rows - 1][j0 + j]
+                            * scale * filter.anticausalGain;
+                    }
+                    y[k] = &state[k * GAUSS_STRIP];
+                }
+                y[0] = &state[0];
+                for (i = rows - 1; i >= 0; i--)
+                {
+                    out = y[0];
+                    for (k = 0; k < 4; k++)
+                    {
+                        x[k] = fixed[min(i + k + 1, rows - 1)] + j0;
+                    }
+                    to = band[i] + j0;
+                    for (j = 0; j < width; j++)
+                    {
+                        out[j] = scale * (b[0] * x[0][j] + b[1] * x[1][j]
+                            + b[2] * x[2][j] + b[3] * x[3][j])
+                            - f[0] * y[1][j] - f[1] * y[2][j]
+                            - f[2] * y[3][j] - f[3] * y[4][j];
+                        value = (int)(out[j] + causal[(size_t)i * GAUSS_STRIP + j] + 0.5);
+                        to[j] = (pixel)(value < 0 ? 0 : value > 255 ? 255 : value);
+                    }
+                    y[0] = y[4];
+                    y[4] = y[3];
+                    y[3] = y[2];
+                    y[2] = y[1];
+                    y[1] = out;
+                }
+            }
+        });
+    }
+
+    free2DInt(fixed, rows);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Replaces each pixel with the median of the (2 * radius + 1) squared box
+ * around it, in each colorband on its own, removing salt and pepper noise
+ * without smearing it. Uses the constant time method of Perreault and
+ * Hebert: a histogram is kept for each column of the box, stepped down a
+ * row by taking out the row leaving and adding the row entering, and the
+ * histogram of the box is stepped right by adding the column entering and
+ * taking out the column leaving. Histograms have 16 coarse bins of 16 fine
+ * bins each. The coarse bins of the box are kept at every step, and the
+ * fine bins of a coarse bin only when the median falls in it, so a pixel
+ * costs the same whatever the radius. The edge of the image is treated by
+ * the border mode.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] radius - radius of the box, up to MAX_MEDIAN
+ *
+ *****************************************************************************/
+void imageMedian(image& img, int radius)
+{
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    int rows = img.rows, cols = img.cols, c, i;
+    int width = 2 * radius + 1, padded = cols + 2 * radius;
+    int rank = width * width / 2;
+    pixel** median = alloc2D(rows, cols);
+    pixel** band;
+
+    for (c = 0; c < 3; c++)
+    {
+        band = bands[c];
+        if (band == nullptr) continue;
+
+        parallelRows(rows, threadCount(rows), [&](int first, int last, int)
+        {
+            vector<pixel> ring((size_t)(width + 1) * padded);
+            vector<uint16_t> colCoarse((size_t)padded * 16);
+            vector<uint16_t> colFine((size_t)padded * 256);
+            uint16_t coarse[16], fine[16][16];
+            int fineCol[16];
+            const uint16_t* enter;
+            const uint16_t* leave;
+            pixel* row;
+            int i, j, k, b, v, x, sum;
+
+            // padded rows of the box, each kept until it leaves the box
+            auto ringRow = [&](int n) -> pixel*
+            {
+                return &ring[(size_t)((n % (width + 1) + width + 1) % (width + 1))
+                    * padded];
+            };
+            auto countRow = [&](const pixel* row, int count)
+            {
+                for (k = 0; k < padded; k++)
+                {
+                    colCoarse[k * 16 + (row[k] >> 4)] += count;
+                    colFine[k * 256 + row[k]] += count;
+                }
+            };
+
+            for (x = first - radius; x <= first + radius; x++)
+            {
+                row = ringRow(x);
+                borderRow(row, band, x, -radius, padded, rows, cols);
+                countRow(row, 1);
+            }
+
+            for (i = first; i < last; i++)
+            {
+                // step the column histograms down a row
+                if (i > first)
+                {
+                    countRow(ringRow(i - radius - 1), -1);
+                    row = ringRow(i + radius);
+                    borderRow(row, band, i + radius, -radius, padded, rows, cols);
+                    countRow(row, 1);
+                }
+
+                // coarse bins of the box at the start of the row, the fine
+                // bins are not kept for any column yet
+                memset(coarse, 0, sizeof(coarse));
+                for (k = 0; k < width; k++)
+                {
+                    for (b = 0; b < 16; b++)
+                    {
+                        coarse[b] += colCoarse[k * 16 + b];
+                    }
+                }
+                for (b = 0; b < 16; b++)
+                {
+                    fineCol[b] = -width - 1;
+                }
+
+                for (j = 0; j < cols; j++)
+                {
+                    if (j > 0)
+                    {
+                        enter = &colCoarse[(j + 2 * radius) * 16];
+                        leave = &colCoarse[(j - 1) * 16];
+                        for (b = 0; b < 16; b++)
+                        {
+                            coarse[b] += enter[b] - leave[b];
+                        }
+                    }
+
+                    // find the coarse bin of the median
+                    sum = 0;
+                    for (b = 0; sum + coarse[b] <= rank; b++)
+                    {
+                        sum += coarse[b];
+                    }
+
+                    // bring its fine bins to this column, starting over if
+                    // the box has moved past every column they were kept for
+                    if (j - fineCol[b] > width)
+                    {
+                        memset(fine[b], 0, sizeof(fine[b]));
+                        for (k = j; k < j + width; k++)
+                        {
+                            enter = &colFine[k * 256 + b * 16];
+                            for (v = 0; v < 16; v++)
+                            {
+                                fine[b][v] += enter[v];
+                            }
+                        }
+                    }
+                    else {
+                        for (k = fineCol[b] + 1; k <= j; k++)
+                        {
+                            enter = &colFine[(k + 2 * radius) * 256 + b * 16];
+                            leave = &colFine[(k - 1) * 256 + b * 16];
+                            for (v = 0; v < 16; v++)
+                            {
+                                fine[b][v] += enter[v] - leave[v];
+                            }
+                        }
+                    }
+                    fineCol[b] = j;
+
+                    for (v = 0; sum + fine[b][v] <= rank; v++)
+                    {
+                        sum += fine[b][v];
+                    }
+                    median[i][j] = (pixel)(b * 16 + v);
+                }
+            }
+        });
+
+        copy2D(median, band, rows, cols);
+
+        // a black border has no full neighborhood
+        if (getBorderMode() == BLACK_BORDER)
+        {
+            for (i = 0; i < rows; i++)
+            {
+                if (i < radius || i >= rows - radius || cols <= 2 * radius)
+                {
+                    memset(band[i], 0, cols);
+                }
+                else {
+                    memset(band[i], 0, radius);
+                    memset(band[i] + cols - radius, 0, radius);
+                }
+            }
+        }
+    }
+
+    free2D(median, rows);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Takes the largest or smallest value in a window of size rows around each
+ * row of a colorband, all the columns of a row at once, with the method of
+ * van Herk and Gil and Werman. The rows are cut into blocks of size rows.
+ * A window then covers the end of one block and the start of the next, so
+ * it is the extreme of a running extreme up from the block end and a
+ * running extreme down from the next block's start: three row operations
+ * per row whatever the size. Rows past the edge of the image are left out.
+ *
+ * @param[in] from - colorband to read
+ * @param[out] to - colorband of extremes, not the same as from
+ * @param[in] rows - rows in the colorbands
+ * @param[in] cols - columns in the colorbands
+ * @param[in] size - rows in the window
+ * @param[in] anchor - rows in the window above the row it is for
+ * @param[in] maximum - true for the largest value, false for the smallest
+ *
+ *****************************************************************************/
+static void morphColumns(pixel** from, pixel** to, int rows, int cols,
+    int size, int anchor, bool maximum)
+{
+    int blocks = (rows + size - 1) / size;
+
+    parallelRows(blocks, min(threadCount(rows), blocks),
+        [&](int first, int last, int)
+    {
+        vector<pixel> neutral(cols, maximum ? 0 : 255);
+        vector<pixel> down((size_t)size * cols), up((size_t)size * cols);
+        int k, s, t, i, x;
+
+        // window row t starts at row t - anchor of the image
+        auto input = [&](int t) -> const pixel*
+        {
+            x = t - anchor;
+            return x >= 0 && x < rows ? from[x] : neutral.data();
+        };
+
+        for (k = first; k < last; k++)
+        {
+            s = k * size;
+
+            // extremes from each row of block k to its end
+            memcpy(&down[(size_t)(size - 1) * cols], input(s + size - 1), cols);
+            for (t = size - 2; t >= 0; t--)
+            {
+                extremeRow(&down[(size_t)t * cols], &down[(size_t)(t + 1) * cols],
+                    input(s + t), cols, maximum);
+            }
+
+            // extremes from the start of block k + 1 to each of its rows
+            memcpy(&up[0], input(s + size), cols);
+            for (t = 1; t < size - 1; t++)
+            {
+                extremeRow(&up[(size_t)t * cols], &up[(size_t)(t - 1) * cols],
+                    input(s + size + t), cols, maximum);
+            }
+
+            // the window for row s + t is rows t to size - 1 of block k and
+            // rows 0 to t - 1 of block k + 1
+            memcpy(to[s], &down[0], cols);
+            for (t = 1; t < size && s + t < rows; t++)
+            {
+                i = s + t;
+                extremeRow(to[i], &down[(size_t)t * cols],
+                    &up[(size_t)(t - 1) * cols], cols, maximum);
+            }
+        }
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Takes the largest or smallest value in a window of size columns around
+ * each pixel of a colorband with the method of van Herk and Gil and
+ * Werman, as morphColumns does down the columns. The running extremes
+ * along a row are found one value at a time and combined a row at a time.
+ * Columns past the edge of the image are left out.
+ *
+ * @param[in] from - colorband to read
+ * @param[out] to - colorband of extremes, may be the same as from
+ * @param[in] rows - rows in the colorbands
+ * @param[in] cols - columns in the colorbands
+ * @param[in] size - columns in the window
+ * @param[in] anchor - columns in the window left of the pixel it is for
+ * @param[in] maximum - true for the largest value, false for the smallest
+ *
+ *****************************************************************************/
+static void morphRows(pixel** from, pixel** to, int rows, int cols,
+    int size, int anchor, bool maximum)
+{
+    parallelRows(rows, threadCount(rows), [&](int first, int last, int)
+    {
+        int length = cols + size - 1;
+        vector<pixel> line(length), down(length), up(length);
+        int i, j;
+
+        for (i = first; i < last; i++)
+        {
+            // window j covers line[j] to line[j + size - 1]
+            memset(line.data(), maximum ? 0 : 255, length);
+            memcpy(&line[anchor], from[i], cols);
+
+            for (j = 0; j < length; j++)
+            {
+                up[j] = j % size == 0 ? line[j] : maximum
+                    ? max(up[j - 1], line[j]) : min(up[j - 1], line[j]);
+            }
+            for (j = length - 1; j >= 0; j--)
+            {
+                down[j] = j % size == size - 1 || j == length - 1 ? line[j]
+                    : maximum ? max(down[j + 1], line[j]) : min(down[j + 1], line[j]);
+            }
+
+            extremeRow(to[i], &down[0], &up[size - 1], cols, maximum);
+        }
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Erodes or dilates every colorband of an image with a rectangle. Each
+ * colorband is done down its columns into a temporary colorband, then
+ * along its rows back into place.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] elemRows - rows in the rectangle
+ * @param[in] elemCols - columns in the rectangle
+ * @param[in] maximum - true to dilate, false to erode
+ *
+ *****************************************************************************/
+static void morphImage(image& img, int elemRows, int elemCols, bool maximum)
+{
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    pixel** temp = alloc2D(img.rows, img.cols);
+    int c;
+
+    // dilation reads the rectangle reflected about the pixel
+    int rowAnchor = maximum ? elemRows - 1 - elemRows / 2 : elemRows / 2;
+    int colAnchor = maximum ? elemCols - 1 - elemCols / 2 : elemCols / 2;
+
+    for (c = 0; c < 3; c++)
+    {
+        if (bands[c] == nullptr) continue;
+
+        morphColumns(bands[c], temp, img.rows, img.cols, elemRows, rowAnchor,
+            maximum);
+        morphRows(temp, bands[c], img.rows, img.cols, elemCols, colAnchor,
+            maximum);
+    }
+
+    free2D(temp, img.rows);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Erodes an image, replacing each pixel with the smallest value in the
+ * rectangle around it. Takes the same time whatever the rectangle's size.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] elemRows - rows in the rectangle
+ * @param[in] elemCols - columns in the rectangle
+ *
+ *****************************************************************************/
+void imageErode(image& img, int elemRows, int elemCols)
+{
+    morphImage(img, elemRows, elemCols, false);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Dilates an image, replacing each pixel with the largest value in the
+ * rectangle around it. Takes the same time whatever the rectangle's size.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] elemRows - rows in the rectangle
+ * @param[in] elemCols - columns in the rectangle
+ *
+ *****************************************************************************/
+void imageDilate(image& img, int elemRows, int elemCols)
+{
+    morphImage(img, elemRows, elemCols, true);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Opens an image, eroding and then dilating it, which removes bright
+ * details smaller than the rectangle
+ *
+ * @param[in,out] img - image structure
+ * @param[in] elemRows - rows in the rectangle
+ * @param[in] elemCols - columns in the rectangle
+ *
+ *****************************************************************************/
+void imageOpen(image& img, int elemRows, int elemCols)
+{
+    morphImage(img, elemRows, elemCols, false);
+    morphImage(img, elemRows, elemCols, true);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Closes an image, dilating and then eroding it, which fills dark details
+ * smaller than the rectangle
+ *
+ * @param[in,out] img - image structure
+ * @param[in] elemRows - rows in the rectangle
+ * @param[in] elemCols - columns in the rectangle
+ *
+ *****************************************************************************/
+void imageClose(image& img, int elemRows, int elemCols)
+{
+    morphImage(img, elemRows, elemCols, true);
+    morphImage(img, elemRows, elemCols, false);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Thresholds each colorband of an image against the mean and standard
+ * deviation of the box of radius around each pixel, with Sauvola's rule.
+ * A pixel becomes 255 if it is above mean * (1 + k * (deviation / R - 1))
+ * and 0 if not, so flat areas fall below their mean and busy ones split at
+ * it. The sums of each box come from a summed-area table of the colorband,
+ * so a pixel costs the same whatever the radius. Boxes are cut off at the
+ * edge of the image.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] radius - rows and columns of the box on each side of the pixel
+ *
+ *****************************************************************************/
+void imageThreshold(image& img, int radius)
+{
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    int rows = img.rows, cols = img.cols, c;
+
+    for (c = 0; c < 3; c++)
+    {
+        if (bands[c] == nullptr) continue;
+
+        summedArea table = buildSummedArea(bands[c], rows, cols, true);
+        pixel** band = bands[c];
 
-    for (i = 0; i < img.rows; i++)
-    {
-        for (j = 0; j < img.cols; j++)
+        parallelRows(rows, threadCount(rows), [&](int first, int last, int)
         {
-            img.redgray[i][j] = 255 - img.redgray[i][j];
-            img.green[i][j] = 255 - img.green[i][j];
-            img.blue[i][j] = 255 - img.blue[i][j];
-        }
+            int i, j, top, bottom, left, right;
+            double count, mean, deviation;
+
+            for (i = first; i < last; i++)
+            {
+                top = max(i - radius, 0);
+                bottom = min(i + radius + 1, rows);
+                for (j = 0; j < cols; j++)
+                {
+                    left = max(j - radius, 0);
+                    right = min(j + radius + 1, cols);
+                    count = (double)(bottom - top) * (right - left);
+                    mean = areaSum(table, top, left, bottom, right) / count;
+                    deviation = sqrt(max(areaSquares(table, top, left, bottom,
+                        right) / count - mean * mean, 0.0));
+                    band[i][j] = band[i][j] > mean * (1 + SAUVOLA_K
+                        * (deviation / SAUVOLA_RANGE - 1)) ? 255 : 0;
+                }
+            }
+        });
+
+        freeSummedArea(table);
     }
 }
 
+/**
+ * @brief Cells of a bilateral grid. Each cell holds a sum for each colorband
+ * and the weight of the pixels summed, in floats next to each other.
+ */
+struct bilateralGrid
+{
+    int rows;     /**< Cells down the image */
+    int cols;     /**< Cells across the image */
+    int levels;   /**< Cells of gray value */
+    int channels; /**< Floats in each cell */
+    double space; /**< Pixels across a cell */
+    double range; /**< Gray values across a cell */
+};
+
 /** ***************************************************************************
  * @author Adam Kraus
  *
  * @par Description:
- * Brighten image color values
+ * Works out the cells of the bilateral grid for an image. A cell is a
+ * standard deviation wide along each axis, with GRID_PAD empty cells past
+ * the nearest cell of the last pixel and the last gray value.
  *
- * @param[in,out] img - image structure
- * @param[in] value - value to be added to color values
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ * @param[in] spaceSigma - standard deviation in pixels
+ * @param[in] rangeSigma - standard deviation in gray value
+ * @param[in] bands - number of colorbands in the image
+ *
+ * @returns returns the grid's size
  *
  *****************************************************************************/
-void imageBrighten(image& img, int value)
+static bilateralGrid gridShape(int rows, int cols, double spaceSigma,
+    double rangeSigma, int bands)
 {
-    int i, j;
+    bilateralGrid grid;
 
-    for (i = 0; i < img.rows; i++)
-    {
-        for (j = 0; j < img.cols; j++)
-        {
-            img.redgray[i][j] = cropNum(img.redgray[i][j] + value);
-            img.green[i][j] = cropNum(img.green[i][j] + value);
-            img.blue[i][j] = cropNum(img.blue[i][j] + value);
-        }
-    }
+    grid.rows = (int)((rows - 1) / spaceSigma + 0.5) + 1 + 2 * GRID_PAD;
+    grid.cols = (int)((cols - 1) / spaceSigma + 0.5) + 1 + 2 * GRID_PAD;
+    grid.levels = (int)(255 / rangeSigma + 0.5) + 1 + 2 * GRID_PAD;
+    grid.channels = bands + 1;
+    grid.space = spaceSigma;
+    grid.range = rangeSigma;
+
+    return grid;
 }
 
 /** ***************************************************************************
  * @author Adam Kraus
  *
  * @par Description:
- * Sharpens image
+ * Blurs a line of grid cells with the 5 tap binomial filter, a Gaussian of
+ * one cell. Cells past the ends of the line are empty.
  *
- * @param[in,out] img - image structure
+ * @param[in,out] first - first float of the first cell
+ * @param[in] count - cells in the line
+ * @param[in] stride - floats from one cell of the line to the next
+ * @param[in] width - floats blurred together in each cell
+ * @param[in] copy - scratch space, resized to count * width floats
  *
  *****************************************************************************/
-void imageSharpen(image& img)
+static void blurLine(float* first, int count, size_t stride, int width,
+    vector<float>& copy)
 {
-    int i, j, rows = img.rows, cols = img.cols;
-    int b, d, f, h;
+    const float tap[5] = { 1 / 16.0f, 4 / 16.0f, 6 / 16.0f, 4 / 16.0f, 1 / 16.0f };
+    float* cell;
+    int k, q, w;
 
-    pixel** newRed = alloc2D(rows, cols);
-    pixel** newGreen = alloc2D(rows, cols);
-    pixel** newBlue = alloc2D(rows, cols);
+    copy.resize((size_t)count * width);
+    for (k = 0; k < count; k++)
+    {
+        memcpy(&copy[(size_t)k * width], first + k * stride, width * sizeof(float));
+    }
 
-    for (i = 0; i < img.rows; i++)
+    for (k = 0; k < count; k++)
     {
-        for (j = 0; j < img.cols; j++)
+        cell = first + k * stride;
+        for (w = 0; w < width; w++)
         {
-            if (i == 0 || i == img.rows - 1 || j == 0 || j == img.cols - 1)
+            cell[w] = 0;
+        }
+        for (q = max(k - 2, 0); q <= min(k + 2, count - 1); q++)
+        {
+            for (w = 0; w < width; w++)
             {
-                newRed[i][j] = 0;
-                newGreen[i][j] = 0;
-                newBlue[i][j] = 0;
-            }
-            else {
-                getSurrSha(img.redgray, b, d, f, h, i, j);
-                newRed[i][j] = cropNum(5 * img.redgray[i][j] - b - d - f - h);
-
-                getSurrSha(img.green, b, d, f, h, i, j);
-                newGreen[i][j] = cropNum(5 * img.green[i][j] - b - d - f - h);
-
-                getSurrSha(img.blue, b, d, f, h, i, j);
-                newBlue[i][j] = cropNum(5 * img.blue[i][j] - b - d - f - h);
+                cell[w] += tap[q - k + 2] * copy[(size_t)q * width + w];
             }
         }
     }
-
-    copy2D(newRed, img.redgray, rows, cols);
-    copy2D(newGreen, img.green, rows, cols);
-    copy2D(newBlue, img.blue, rows, cols);
-    
-    free2D(newRed, rows);
-    free2D(newGreen, rows);
-    free2D(newBlue, rows);
 }
 
 /** ***************************************************************************
  * @author Adam Kraus
  *
  * @par Description:
- * Gets the surrounding values of the location not including diagonally
+ * Works out how many rows of cells each strip of the bilateral grid
+ * finishes. A strip also holds the GRID_PAD rows its blur reads above and
+ * the GRID_PAD + 1 rows below, since the last pixels read one row further,
+ * and all of it is kept within GRID_STRIP_BYTES when it can be. A strip
+ * finishes more than GRID_PAD rows, so only the pixels of the strip just
+ * before are still needed by the next one.
+ *
+ * @param[in] grid - the grid's size
  *
- * @param[in] colorband - the colorband to get values from
- * @param[out] b - value above current position
- * @param[out] d - value left of current position
- * @param[out] f - value right of current position
- * @param[out] h - value below current postion
- * @param[out] iPos - current row position
- * @param[out] jPos - current column position
+ * @returns returns the rows of cells finished by each strip
  *
  *****************************************************************************/
-void getSurrSha(pixel**& colorband, int& b, int& d, int& f, int& h, int iPos, int jPos)
+static int gridStripRows(const bilateralGrid& grid)
 {
-    b = colorband[iPos - 1][jPos];
-    d = colorband[iPos][jPos - 1];
-    f = colorband[iPos][jPos + 1];
-    h = colorband[iPos + 1][jPos];
+    int floats = grid.cols * grid.levels * grid.channels;
+    size_t rowBytes = sumStride(floats, sizeof(float)) * sizeof(float);
+
+    return max((int)(GRID_STRIP_BYTES / rowBytes) - 2 * GRID_PAD - 1,
+        GRID_PAD + 1);
 }
 
 /** ***************************************************************************
  * @author Adam Kraus
  *
  * @par Description:
- * Smooths image by averaging values of 3x3 around a pixel
+ * Smooths an image while keeping its edges, approximating a bilateral
+ * filter with the bilateral grid of Paris and Durand. Every pixel is added
+ * into the cell of the grid nearest its row, column and gray value, the
+ * grid is blurred along its three axes, and each pixel is read back from
+ * the grid between the cells around it. Pixels on the other side of an
+ * edge are far away in gray value, so they land in other cells and barely
+ * mix. A cell is a standard deviation along each axis, so the work shrinks
+ * as either standard deviation grows. Color images use the gray value of
+ * each pixel for all three colorbands.
+ *
+ * The grid is worked through in strips of rows of cells, so small standard
+ * deviations do not need the whole grid at once. Each strip is filled and
+ * blurred with the rows around it that its blur reads, and the rows it
+ * finishes come out the same as they would from the whole grid. The last
+ * few rows of pixels a strip finishes are held back until the next strip
+ * has been filled from them.
  *
  * @param[in,out] img - image structure
+ * @param[in] spaceSigma - standard deviation in pixels
+ * @param[in] rangeSigma - standard deviation in gray value
  *
  *****************************************************************************/
-void imageSmooth(image& img)
+void imageBilateral(image& img, double spaceSigma, double rangeSigma)
 {
-    int iPos, jPos, rows = img.rows, cols = img.cols;
-    int a, b, c, d, f, g, h, i;
-    double average;
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    int rows = img.rows, cols = img.cols, channels = imageChannels(img);
+    bilateralGrid grid = gridShape(rows, cols, spaceSigma, rangeSigma, channels);
+    size_t colStride = (size_t)grid.levels * grid.channels;
+    size_t rowStride = grid.cols * colStride;
+    size_t pitch = sumStride((int)rowStride, sizeof(float));
+    int stripRows = gridStripRows(grid);
+    float** strip = alloc2DGrid(min(stripRows + 2 * GRID_PAD + 1, grid.rows),
+        (int)rowStride);
+    vector<int> nearRow(rows), downRow(rows), nearCol(cols), leftCol(cols);
+    vector<int> levelCell(256);
+    vector<float> leftFrac(cols), levelFrac(256);
+    vector<pixel> held;
+    int threads = threadCount(rows), i, j, v, start, stop, low, high, keep;
+    int heldFirst = 0, heldLast = 0;
 
-    pixel** newRed = alloc2D(rows, cols);
-    pixel** newGreen = alloc2D(rows, cols);
-    pixel** newBlue = alloc2D(rows, cols);
+    auto gray = [&](int i, int j) -> int
+    {
+        return channels == 1 ? bands[0][i][j]
+            : grayValue(bands[0][i][j], bands[1][i][j], bands[2][i][j]);
+    };
 
-    for (iPos = 0; iPos < img.rows; iPos++)
+    // writes the held back rows of pixels into the image
+    auto release = [&]()
     {
-        for (jPos = 0; jPos < img.cols; jPos++)
+        int i, c;
+
+        for (i = heldFirst; i < heldLast; i++)
         {
-            if (iPos == 0 || iPos == img.rows - 1 
-                || jPos == 0 || jPos == img.cols - 1)
+            for (c = 0; c < channels; c++)
             {
-                newRed[iPos][jPos] = 0;
-                newGreen[iPos][jPos] = 0;
-                newBlue[iPos][jPos] = 0;
+                memcpy(bands[c][i], &held[((size_t)(i - heldFirst) * channels + c)
+                    * cols], cols * sizeof(pixel));
             }
-            else {
-                getSurrSmo(img.redgray, a, b, c, d, f, g, h, i, iPos, jPos);
-                average = ((unsigned long)a + b + c + d + img.redgray[iPos][jPos]
-                    + f + g + h + i) / 9.0;
-                newRed[iPos][jPos] = cropNum((int)average);
+        }
+        heldFirst = heldLast;
+    };
+
+    // the cells of each row and column are the same all across the image
+    for (i = 0; i < rows; i++)
+    {
+        nearRow[i] = (int)(i / grid.space + 0.5) + GRID_PAD;
+        downRow[i] = (int)(float)(i / grid.space + GRID_PAD);
+    }
+    for (j = 0; j < cols; j++)
+    {
+        nearCol[j] = (int)(j / grid.space + 0.5) + GRID_PAD;
+        leftCol[j] = (int)(j / grid.space) + GRID_PAD;
+        leftFrac[j] = (float)(j / grid.space + GRID_PAD - leftCol[j]);
+    }
+    for (v = 0; v < 256; v++)
+    {
+        levelCell[v] = (int)(v / grid.range) + GRID_PAD;
+        levelFrac[v] = (float)(v / grid.range + GRID_PAD - levelCell[v]);
+    }
+
+    // rows [start, stop) of cells are finished from rows [low, high)
+    for (start = 0; start < grid.rows; start = stop)
+    {
+        stop = min(start + stripRows, grid.rows);
+        low = max(start - GRID_PAD, 0);
+        high = min(stop + GRID_PAD + 1, grid.rows);
 
-                getSurrSmo(img.green, a, b, c, d, f, g, h, i, iPos, jPos);
-                average = ((unsigned long)a + b + c + d + img.green[iPos][jPos]
-                    + f + g + h + i) / 9.0;
-                newGreen[iPos][jPos] = cropNum((int)average);
+        // each thread adds the pixels nearest its own rows of cells
+        parallelRows(high - low, min(threads, high - low),
+            [&](int first, int last, int)
+        {
+            float* cell;
+            int i, j, c, x;
 
-                getSurrSmo(img.blue, a, b, c, d, f, g, h, i, iPos, jPos);
-                average = ((unsigned long)a + b + c + d + img.blue[iPos][jPos]
-                    + f + g + h + i) / 9.0;
-                newBlue[iPos][jPos] = cropNum((int)average);
+            i = (int)(lower_bound(nearRow.begin(), nearRow.end(), low + first)
+                - nearRow.begin());
+            for (x = first; x < last; x++)
+            {
+                memset(strip[x], 0, rowStride * sizeof(float));
             }
-        }
-    }
+            for (; i < rows && nearRow[i] < low + last; i++)
+            {
+                x = nearRow[i] - low;
+                for (j = 0; j < cols; j++)
+                {
+                    cell = strip[x] + nearCol[j] * colStride
+                        + ((int)(gray(i, j) / grid.range + 0.5) + GRID_PAD)
+                        * grid.channels;
+                    for (c = 0; c < channels; c++)
+                    {
+                        cell[c] += bands[c][i][j];
+                    }
+                    cell[channels] += 1;
+                }
+            }
+        });
+
+        release();
+
+        // blur along gray value and across, a row of cells at a time
+        parallelRows(high - low, min(threads, high - low),
+            [&](int first, int last, int)
+        {
+            vector<float> copy;
+            int x, y;
+
+            for (x = first; x < last; x++)
+            {
+                for (y = 0; y < grid.cols; y++)
+                {
+                    blurLine(strip[x] + y * colStride, grid.levels,
+                        grid.channels, grid.channels, copy);
+                }
+                blurLine(strip[x], grid.cols, colStride, (int)colStride, copy);
+            }
+        });
+
+        // blur down, a column of cells at a time
+        parallelRows(grid.cols, min(threads, grid.cols),
+            [&](int first, int last, int)
+        {
+            vector<float> copy;
+            int y;
+
+            for (y = first; y < last; y++)
+            {
+                blurLine(strip[0] + y * colStride, high - low, pitch,
+                    (int)colStride, copy);
+            }
+        });
+
+        // read each pixel of the finished rows back from the eight cells
+        // around it, blending the two rows of cells first since they are
+        // the same for a whole row of pixels, and hold back the rows the
+        // next strip is still filled from
+        i = (int)(lower_bound(downRow.begin(), downRow.end(), start)
+            - downRow.begin());
+        j = (int)(lower_bound(downRow.begin(), downRow.end(), stop)
+            - downRow.begin());
+        keep = stop == grid.rows ? j : (int)(lower_bound(nearRow.begin(),
+            nearRow.end(), stop - GRID_PAD) - nearRow.begin());
+        keep = max(keep, i);
+        held.resize((size_t)(j - keep) * channels * cols);
+        heldFirst = keep;
+        heldLast = j;
+        parallelRows(j - i, threadCount(j - i), [&, i](int first, int last, int)
+        {
+            vector<float> blend(rowStride);
+            float sum[4], down, across, weight, scale;
+            const float* corner;
+            const float* upper;
+            const float* lower;
+            pixel* out[3];
+            size_t k;
+            int r, j, c, v, z, dy, dz;
+
+            for (r = i + first; r < i + last; r++)
+            {
+                for (c = 0; c < channels; c++)
+                {
+                    out[c] = r < keep ? bands[c][r]
+                        : &held[((size_t)(r - keep) * channels + c) * cols];
+                }
+                down = (float)(r / grid.space + GRID_PAD);
+                upper = strip[downRow[r] - low];
+                lower = strip[downRow[r] - low + 1];
+                down -= downRow[r];
+                for (k = 0; k < rowStride; k++)
+                {
+                    blend[k] = upper[k] + down * (lower[k] - upper[k]);
+                }
+
+                for (j = 0; j < cols; j++)
+                {
+                    v = gray(r, j);
+                    z = levelCell[v];
+                    for (c = 0; c <= channels; c++)
+                    {
+                        sum[c] = 0;
+                    }
+                    for (dy = 0; dy < 2; dy++)
+                    {
+                        across = dy ? leftFrac[j] : 1 - leftFrac[j];
+                        for (dz = 0; dz < 2; dz++)
+                        {
+                            weight = across * (dz ? levelFrac[v] : 1 - levelFrac[v]);
+                            corner = &blend[(leftCol[j] + dy) * colStride
+                                + (z + dz) * grid.channels];
+                            for (c = 0; c <= channels; c++)
+                            {
+                                sum[c] += weight * corner[c];
+                            }
+                        }
+                    }
 
-    copy2D(newRed, img.redgray, rows, cols);
-    copy2D(newGreen, img.green, rows, cols);
-    copy2D(newBlue, img.blue, rows, cols);
+                    scale = 1 / sum[channels];
+                    for (c = 0; c < channels; c++)
+                    {
+                        out[c][j] = (pixel)cropNum((int)(sum[c] * scale + 0.5f));
+                    }
+                }
+            }
+        });
+    }
 
-    free2D(newRed, rows);
-    free2D(newGreen, rows);
-    free2D(newBlue, rows);
+    release();
+    free2DGrid(strip);
 }
 
 /** ***************************************************************************
  * @author Adam Kraus
  *
  * @par Description:
- * Gets the surrounding values of the location including diagonally
+ * Predicts the bytes of the strip of the bilateral grid imageBilateral
+ * holds at once for a color image
  *
- * @param[in] colorband - the colorband to get values from
- * @param[out] a - value above/left of current postion
- * @param[out] b - value above current position
- * @param[out] c - value above/right current postion
- * @param[out] d - value left of current position
- * @param[out] f - value right of current position
- * @param[out] g - value below/left of current position
- * @param[out] h - value below current postion
- * @param[out] i - value below/right of current position
- * @param[out] iPos - current row position
- * @param[out] jPos - current column position
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ * @param[in] spaceSigma - standard deviation in pixels
+ * @param[in] rangeSigma - standard deviation in gray value
+ *
+ * @returns returns the predicted bytes
  *
  *****************************************************************************/
-void getSurrSmo(pixel**& colorband, int& a, int& b, int& c, int& d, int& f, int& g, int& h, int& i, int iPos, int jPos)
+size_t bilateralBytes(int rows, int cols, double spaceSigma, double rangeSigma)
 {
-    a = colorband[iPos - 1][jPos - 1];
-    b = colorband[iPos - 1][jPos];
-    c = colorband[iPos - 1][jPos + 1];
-    d = colorband[iPos][jPos - 1];
-    f = colorband[iPos][jPos + 1];
-    g = colorband[iPos + 1][jPos - 1];
-    h = colorband[iPos + 1][jPos];
-    i = colorband[iPos + 1][jPos + 1];
+    bilateralGrid grid = gridShape(rows, cols, spaceSigma, rangeSigma, 3);
+
+    return sumBytes(min(gridStripRows(grid) + 2 * GRID_PAD + 1, grid.rows),
+        grid.cols * grid.levels * grid.channels, sizeof(float));
 }
 
 /** ***************************************************************************
@@ -228,71 +1237,202 @@ void getSurrSmo(pixel**& colorband, int& a, int& b, int& c, int& d, int& f, int&
  *****************************************************************************/
 void imageGrayscale(image& img)
 {
-    int i, j;
+    grayscaleBands(img.redgray, img.green, img.blue, img.redgray, img.rows,
+        img.cols);
+
+    free2D(img.blue, img.rows);
+    free2D(img.green, img.rows);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Applies a chain of point operations to an image in one pass. Converting
+ * to grayscale is fused with the tables on either side of it, so no
+ * colorband is swept more than once.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] chain - chain of point operations
+ *
+ *****************************************************************************/
+void imagePointChain(image& img, const pointChain& chain)
+{
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    pointTable both = composeTables(chain.before, chain.after);
+    int k;
+
+    if (chain.gray && img.green != nullptr)
+    {
+        evaluate(img.redgray, img.rows, img.cols, lookup(grayPixel(
+            lookup(colorBand(img.redgray), chain.before),
+            lookup(colorBand(img.green), chain.before),
+            lookup(colorBand(img.blue), chain.before)), chain.after));
 
-    pixel** grayscale = alloc2D(img.rows, img.cols);
+        free2D(img.blue, img.rows);
+        free2D(img.green, img.rows);
+        return;
+    }
 
-    for (i = 0; i < img.rows; i++)
+    for (k = 0; k < 3; k++)
     {
-        for (j = 0; j < img.cols; j++)
+        if (bands[k] != nullptr)
         {
-            grayscale[i][j] = cropNum((int)round(0.3 * img.redgray[i][j]
-                + 0.6 * img.green[i][j] + 0.1 * img.blue[i][j]));
+            evaluate(bands[k], img.rows, img.cols,
+                lookup(colorBand(bands[k]), both));
         }
     }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Convert image to grayscale and counts the gray values. Each row is
+ * converted by imageHistogram just before it is counted, while it is
+ * still in cache.
+ *
+ * @param[in,out] img - image structure
+ *
+ * @returns returns the histogram of the gray values
+ *
+ *****************************************************************************/
+histogram grayscaleHistogram(image& img)
+{
+    histogram hist = imageHistogram(img, 1, [&](int i)
+    {
+        grayscaleBands(img.redgray + i, img.green + i, img.blue + i,
+            img.redgray + i, 1, img.cols);
+    });
+
+    free2D(img.blue, img.rows);
+    free2D(img.green, img.rows);
+
+    return hist;
+}
 
-    copy2D(grayscale, img.redgray, img.rows, img.cols);
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Convert image to grayscale, then contrasts it. The gray values between
+ * two percentiles are stretched to [0, 255] with one table lookup per
+ * pixel, so a few very dark or bright pixels need not spoil the stretch.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] clip - percent of pixels cropped to 0 and to 255, 0 to stretch
+ * between the min and max values
+ *
+ *****************************************************************************/
+void imageContrast(image& img, double clip)
+{
+    histogram hist = grayscaleHistogram(img);
+    pointTable table = stretchTable(histogramPercentile(hist, 0, clip),
+        histogramPercentile(hist, 0, 100 - clip));
 
-    free2D(grayscale, img.rows);
-    img.blue = nullptr;
-    img.green = nullptr;
+    parallelRows(img.rows, threadCount(img.rows), [&](int first, int last, int)
+    {
+        applyTable(img.redgray + first, last - first, img.cols, table);
+    });
 }
 
 /** ***************************************************************************
  * @author Adam Kraus
  *
  * @par Description:
- * Convert image to grayscale, then contrasts it
+ * Convert image to grayscale, then equalizes its histogram so the gray
+ * values are spread evenly over [0, 255]
  *
  * @param[in,out] img - image structure
  *
  *****************************************************************************/
-void imageContrast(image& img)
+void imageEqualize(image& img)
+{
+    histogram hist = grayscaleHistogram(img);
+    pointTable table = equalizeTable(hist, 0);
+
+    parallelRows(img.rows, threadCount(img.rows), [&](int first, int last, int)
+    {
+        applyTable(img.redgray + first, last - first, img.cols, table);
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes a pipeline stage that smooths by averaging the 3x3 box around each
+ * pixel, as imageSmooth does with radius 1
+ *
+ * @param[in] channels - number of colorbands to smooth
+ *
+ * @returns returns the stage
+ *
+ *****************************************************************************/
+static lineStage boxStage(int channels)
 {
-    imageGrayscale(img);
-    int i, j;
-    int min = img.redgray[0][0], max = img.redgray[0][0];
-    double scale;
+    lineStage stage;
 
-    // find min/max value
-    for (i = 0; i < img.rows; i++)
+    stage.halo = 1;
+    stage.channels = channels;
+    stage.row = [channels](int, pixel** const* in, pixel* const* out, int cols)
     {
-        for (j = 0; j < img.cols; j++)
+        vector<int> sums(cols), scratch(cols + 2);
+        int c, j;
+
+        for (c = 0; c < channels; c++)
         {
-            if (img.redgray[i][j] < min) min = img.redgray[i][j];
-            if (img.redgray[i][j] > max) max = img.redgray[i][j];
+            convolveRow<boxKernel>(in[c], 0, 0, cols, sums.data(),
+                scratch.data());
+            for (j = 0; j < cols; j++)
+            {
+                out[c][j] = (pixel)(sums[j] / 9);
+            }
         }
-    }
+    };
+
+    return stage;
+}
 
-    scale = 255.0 / (max - min);
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes a pipeline stage that converts red, green and blue to gray, as
+ * imageGrayscale does
+ *
+ * @returns returns the stage
+ *
+ *****************************************************************************/
+static lineStage grayStage()
+{
+    lineStage stage;
 
-    for (i = 0; i < img.rows; i++)
+    stage.halo = 0;
+    stage.channels = 1;
+    stage.row = [](int, pixel** const* in, pixel* const* out, int cols)
     {
-        for (j = 0; j < img.cols; j++)
+        const pixel* red = in[0][0];
+        const pixel* green = in[1][0];
+        const pixel* blue = in[2][0];
+        int j;
+
+        for (j = 0; j < cols; j++)
         {
-            img.redgray[i][j] = cropNum((int)round(scale * 
-                (img.redgray[i][j] - min)));
+            out[0][j] = grayValue(red[j], green[j], blue[j]);
         }
-    }
+    };
 
-    //cout << scale << ',' << max << ',' << min << endl;
+    return stage;
 }
 
 /** ***************************************************************************
  * @author Adam Kraus
  *
  * @par Description:
- * Scales an image up or down in size
+ * Scales an image up or down in size, then smooths it. The two are fused
+ * in a line buffered pipeline, so the scaled image is never stored before
+ * it is smoothed.
  *
  * @param[in,out] img - image structure
  * @param[in] scale - percent to scale by, valid scale: [50, 200]
@@ -301,52 +1441,140 @@ void imageContrast(image& img)
 void imageScale(image& img, int scale)
 {
     if (scale < 50 || scale > 200 || scale == 100) return;
-    int i, j;
     double percent = scale / 100.0;
     int newRows = int(img.rows * percent);
     int newCols = int(img.cols * percent);
-    int mappedRow, mappedCol;
+    int j, k;
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    pixel** scaled[3];
+    vector<int> mappedCol(newCols);
+    vector<lineStage> stages(2);
 
-    pixel** newRed = alloc2D(newRows, newCols);
-    pixel** newGreen = alloc2D(newRows, newCols);
-    pixel** newBlue = alloc2D(newRows, newCols);
+    for (j = 0; j < newCols - 1; j++)
+    {
+        mappedCol[j] = mapNum(j, 0.0, (double)newCols, 0.0, (double)img.cols);
+    }
 
-    for (i = 0; i < newRows - 1; i++)
+    // map each new pixel to the nearest old one, the last row and column
+    // are not mapped and stay 0
+    stages[0].halo = 0;
+    stages[0].channels = 3;
+    stages[0].row = [&](int i, pixel** const*, pixel* const* out, int cols)
     {
-        mappedRow = mapNum(i, 0.0, (double)newRows, 0.0, (double)img.rows);
-        for (j = 0; j < newCols - 1; j++)
-        {
-            mappedCol = mapNum(j, 0.0, (double)newCols, 0.0, (double)img.cols);
+        int mappedRow = mapNum(i, 0.0, (double)newRows, 0.0, (double)img.rows);
+        int c, x;
 
-            newRed[i][j] = img.redgray[mappedRow][mappedCol];
-            newGreen[i][j] = img.green[mappedRow][mappedCol];
-            newBlue[i][j] = img.blue[mappedRow][mappedCol];
+        for (c = 0; c < 3; c++)
+        {
+            memset(out[c], 0, cols);
+            for (x = 0; x < cols - 1 && i < newRows - 1; x++)
+            {
+                out[c][x] = bands[c][mappedRow][mappedCol[x]];
+            }
         }
+    };
+    stages[1] = boxStage(3);
+
+    // smooth the new rows as they are mapped
+    for (k = 0; k < 3; k++)
+    {
+        scaled[k] = alloc2D(newRows, newCols);
     }
+    linePipeline(stages, scaled, newRows, newCols);
 
     // free existing colorbands
     free2D(img.redgray, img.rows);
     free2D(img.green, img.rows);
     free2D(img.blue, img.rows);
 
-    // reallocate and copy in new colorbands
-    img.redgray = alloc2D(newRows, newCols);
-    copy2D(newRed, img.redgray, newRows, newCols);
-    img.green = alloc2D(newRows, newCols);
-    copy2D(newGreen, img.green, newRows, newCols);
-    img.blue = alloc2D(newRows, newCols);
-    copy2D(newBlue, img.blue, newRows, newCols);
+    img.redgray = scaled[0];
+    img.green = scaled[1];
+    img.blue = scaled[2];
 
     //set new rows/columns
     img.rows = newRows;
     img.cols = newCols;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes a pipeline stage that reads the rows of a color image
+ *
+ * @param[in] img - image structure, must outlive the stage
+ *
+ * @returns returns the stage
+ *
+ *****************************************************************************/
+static lineStage imageSource(const image& img)
+{
+    lineStage stage;
+
+    stage.halo = 0;
+    stage.channels = 3;
+    stage.row = [&img](int i, pixel** const*, pixel* const* out, int cols)
+    {
+        memcpy(out[0], img.redgray[i], cols);
+        memcpy(out[1], img.green[i], cols);
+        memcpy(out[2], img.blue[i], cols);
+    };
+
+    return stage;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes a pipeline stage that finds the magnitude of the intensity
+ * gradient of a gray image with the Sobel kernels, and the angle of the
+ * gradient rounded to the nearest 45 degrees
+ *
+ * @param[out] gradientAngle - angle of the gradient at each pixel, must
+ * outlive the stage
+ *
+ * @returns returns the stage
+ *
+ *****************************************************************************/
+static lineStage sobelStage(int** gradientAngle)
+{
+    lineStage stage;
+
+    stage.halo = 1;
+    stage.channels = 1;
+    stage.row = [gradientAngle](int i, pixel** const* in, pixel* const* out,
+        int cols)
+    {
+        vector<int> changeX(cols), changeY(cols), scratch(cols + 2);
+        int j, Gx, Gy;
+
+        // compute vertical/horizontal intensity changes along the row
+        convolveRow<sobelXKernel>(in[0], 0, 0, cols, changeX.data(),
+            scratch.data());
+        convolveRow<sobelYKernel>(in[0], 0, 0, cols, changeY.data(),
+            scratch.data());
+
+        for (j = 0; j < cols; j++)
+        {
+            Gx = cropNum(changeX[j]);
+            Gy = cropNum(changeY[j]);
+
+            // set pixel to magnitude of changes
+            out[0][j] = (int)round(sqrt(pow(Gx, 2) + pow(Gy, 2)));
 
-    // free temporary colorbands
-    free2D(newRed, newRows);
-    free2D(newGreen, newRows);
-    free2D(newBlue, newRows);
+            // compute gradient angle
+            if (Gx != 0)
+            {
+                gradientAngle[i][j] = roundAngle(atan(Gy / Gx) * 180 / PI);
+            }
+            else {
+                gradientAngle[i][j] = 90;
+            }
+        }
+    };
 
-    imageSmooth(img);
+    return stage;
 }
 
 /** ***************************************************************************
@@ -363,47 +1591,26 @@ void imageScale(image& img, int scale)
 void imageEdgeDetection(image& img)
 {
     int i, j, rows = img.rows, cols = img.cols,
-        Gx, Gy, lowerThreshold, upperThreshold;
+        lowerThreshold, upperThreshold;
     pixel** newGray = nullptr;
     int** gradientAngle = nullptr;
+    vector<lineStage> stages;
     //bool complete = false;
     //int a, b, c, d, f, g, h, iNum;
 
-    // apply filter to remove noise
-    imageSmooth(img);
-
-    // find the intensity gradients
-    imageGrayscale(img);
     newGray = alloc2D(rows, cols);
     gradientAngle = alloc2DInt(rows, cols);
-    for (i = 0; i < rows; i++)
-    {
-        for (j = 0; j < cols; j++)
-        {
-            if (i == 0 || i == rows - 1 || j == 0 || j == cols - 1)
-            {
-                // ignore border pixel
-                newGray[i][j] = 0;
-            }
-            else {
-                // compute vertical/horizontal intensity changes
-                Gx = sobelX(img, i, j);
-                Gy = sobelY(img, i, j);
 
-                // set pixel to magnitude of changes
-                newGray[i][j] = (int)round(sqrt(pow(Gx, 2) + pow(Gy, 2)));
+    // apply filter to remove noise, then find the intensity gradients of
+    // the gray image, a few rows at a time
+    stages.push_back(imageSource(img));
+    stages.push_back(boxStage(3));
+    stages.push_back(grayStage());
+    stages.push_back(sobelStage(gradientAngle));
+    linePipeline(stages, &newGray, rows, cols);
 
-                // compute gradient angle
-                if (Gx != 0)
-                {
-                    gradientAngle[i][j] = roundAngle(atan(Gy / Gx) * 180 / PI);
-                }
-                else {
-                    gradientAngle[i][j] = 90;
-                }
-            }
-        }
-    }
+    free2D(img.green, rows);
+    free2D(img.blue, rows);
 
     copy2D(newGray, img.redgray, rows, cols);
 
@@ -505,53 +1712,3 @@ void imageEdgeDetection(image& img)
     free2D(newGray, rows);
     free2DInt(gradientAngle, rows);
 }
-
-/** ***************************************************************************
- * @author Adam Kraus
- *
- * @par Description:
- * Calculates change in intensity in the x-direction
- *
- * @param[in,out] img - image structure
- * @param[in] i - current row position
- * @param[in] j - current column position
- * 
- * @returns change in intensity in the x-direction 
- *
- *****************************************************************************/
-int sobelX(image& img, int i, int j)
-{
-    int formulation = 0;
-
-    formulation += (img.redgray[i - 1][j - 1] + 2 * img.redgray[i][j - 1]
-        + img.redgray[i + 1][j - 1]);
-    formulation -= (img.redgray[i - 1][j + 1] + 2 * img.redgray[i][j + 1]
-        + img.redgray[i + 1][j + 1]);
-
-    return cropNum(formulation);
-}
-
-/** ***************************************************************************
- * @author Adam Kraus
- *
- * @par Description:
- * Calculates change in intensity in the y-direction
- *
- * @param[in,out] img - image structure
- * @param[in] i - current row position
- * @param[in] j - current column position
- * 
- * @returns change in intensity in the y-direction
- *
- *****************************************************************************/
-int sobelY(image& img, int i, int j)
-{
-    int formulation = 0;
-
-    formulation += (img.redgray[i - 1][j - 1] + 2 * img.redgray[i - 1][j]
-        + img.redgray[i - 1][j + 1]);
-    formulation -= (img.redgray[i + 1][j - 1] + 2 * img.redgray[i + 1][j]
-        + img.redgray[i + 1][j + 1]);
-
-    return cropNum(formulation);
-}
\ No newline at end of file
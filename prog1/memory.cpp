@@ -7,40 +7,286 @@
 
 #include "netPBM.h"
 
- /** ***************************************************************************
-  * @author Adam Kraus
-  *
-  * @par Description:
-  * Dynamically allocates a 2D pixel array
-  *
-  * @param[in] rows - number of rows in the image
-  * @param[in] cols - number of columns in the image
-  *
-  * @returns returns the pointer to the 2D array
-  *
-  *****************************************************************************/
+#ifdef __linux__
+#include <sys/mman.h>
+#include <stdlib.h>
+#endif
+
+/**
+ * @brief Bytes added to the row stride when it would alias in the cache.
+ * Stencils read tile copies and line buffers, so benchmarks/strideBenchmark
+ * finds the padding within noise; one cache line per row is kept for any
+ * code that still walks vertical neighbors in the planes.
+ */
+static int stridePadding = ROW_ALIGN;
+/**
+ * @brief Bytes currently allocated for each type of 2D array
+ */
+static size_t currentBytes[PLANE_TYPES] = { 0 };
+/**
+ * @brief Most bytes allocated at once for each type of 2D array
+ */
+static size_t peakBytes[PLANE_TYPES] = { 0 };
+/**
+ * @brief Bytes currently allocated for all 2D arrays
+ */
+static size_t totalCurrent = 0;
+/**
+ * @brief Most bytes allocated at once for all 2D arrays
+ */
+static size_t totalPeak = 0;
+/**
+ * @brief Most bytes the 2D arrays may use at once, 0 for no limit
+ */
+static size_t memoryLimit = 0;
+/**
+ * @brief Kind of pages used to back arrays of at least HUGE_PAGE bytes
+ */
+static pageMode largePages = TRANSPARENT_HUGE_PAGES;
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets the padding added to the row stride of newly allocated pixel arrays
+ * whose aligned width is a multiple of ALIAS_STRIDE. Rows that far apart map
+ * to the same cache sets, so stencils reading vertical neighbors evict each
+ * other. A padding of 0 disables this.
+ *
+ * @param[in] bytes - padding in bytes, rounded up to a multiple of ROW_ALIGN
+ *
+ *****************************************************************************/
+void setStridePadding(int bytes)
+{
+    if (bytes < 0) bytes = 0;
+    stridePadding = (bytes + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Computes the distance in bytes between the starts of two rows of a pixel
+ * array. Rows are rounded up to a multiple of ROW_ALIGN and padded if the
+ * result would alias.
+ *
+ * @param[in] cols - number of columns in the image
+ *
+ * @returns returns the row stride in bytes
+ *
+ *****************************************************************************/
+int rowStride(int cols)
+{
+    int stride = (cols + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+
+    if (stride % ALIAS_STRIDE == 0)
+    {
+        stride += stridePadding;
+    }
+
+    return stride;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets the kind of pages used to back arrays of at least HUGE_PAGE bytes.
+ * Huge pages cut the TLB misses of stencils walking large images. Only
+ * Linux supports huge pages, anywhere else normal pages are always used.
+ *
+ * @param[in] mode - kind of pages to use
+ *
+ *****************************************************************************/
+void setPageMode(pageMode mode)
+{
+    largePages = mode;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Tries to get memory backed by huge pages, aligned to HUGE_PAGE. Hugetlbfs
+ * pages must be reserved by the system, so without them this falls back to
+ * transparent huge pages.
+ *
+ * @param[in] bytes - bytes needed, a multiple of HUGE_PAGE
+ * @param[out] kind - kind of pages the memory is backed by
+ *
+ * @returns returns the memory, nullptr if huge pages are not available
+ *
+ *****************************************************************************/
+static char* allocHuge(size_t bytes, pageMode& kind)
+{
+#ifdef __linux__
+    void* mem = nullptr;
+
+#ifdef MAP_HUGETLB
+    if (largePages == HUGETLB_PAGES)
+    {
+        mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED)
+        {
+            kind = HUGETLB_PAGES;
+            return (char*)mem;
+        }
+    }
+#endif
+
+    if (posix_memalign(&mem, HUGE_PAGE, bytes) == 0)
+    {
+#ifdef MADV_HUGEPAGE
+        madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+        kind = TRANSPARENT_HUGE_PAGES;
+        return (char*)mem;
+    }
+#endif
+
+    return nullptr;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Allocates a block of memory for a 2D array and records it in the memory
+ * accounting. The block starts with a planeBlock header, followed by the
+ * data at the first ROW_ALIGN boundary after it. Blocks of at least
+ * HUGE_PAGE bytes are backed by the pages set with setPageMode. Exits if
+ * the memory limit would be exceeded or the allocation fails.
+ *
+ * @param[in] dataBytes - bytes needed for the array data
+ * @param[in] ptrBytes - bytes used by the row pointers of the array
+ * @param[in] type - kind of array the block is for
+ * @param[out] data - aligned start of the array data
+ *
+ * @returns returns the start of the block
+ *
+ *****************************************************************************/
+static char* allocBlock(size_t dataBytes, size_t ptrBytes, planeType type,
+    char*& data)
+{
+    char* block = nullptr;
+    planeBlock* header;
+    size_t bytes = sizeof(planeBlock) + ROW_ALIGN + dataBytes + ptrBytes;
+    size_t blockBytes = bytes - ptrBytes;
+    pageMode kind = NORMAL_PAGES;
+
+    if (memoryLimit != 0 && totalCurrent + bytes > memoryLimit)
+    {
+        cout << "Memory limit of " << memoryLimit / MEGABYTE
+            << " MB exceeded." << endl;
+        exit(1);
+    }
+
+    if (largePages != NORMAL_PAGES && blockBytes >= HUGE_PAGE)
+    {
+        blockBytes = (blockBytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        block = allocHuge(blockBytes, kind);
+    }
+
+    if (block == nullptr)
+    {
+        kind = NORMAL_PAGES;
+        block = new (nothrow) char[blockBytes];
+    }
+
+    if (block == nullptr)
+    {
+        cout << "Not enough memory to run program" << endl;
+        exit(1);
+    }
+
+    header = (planeBlock*)block;
+    header->bytes = bytes;
+    header->mapped = blockBytes;
+    header->type = type;
+    header->pages = kind;
+    data = block + sizeof(planeBlock);
+    data += (ROW_ALIGN - (uintptr_t)data % ROW_ALIGN) % ROW_ALIGN;
+
+    currentBytes[type] += bytes;
+    peakBytes[type] = max(peakBytes[type], currentBytes[type]);
+    totalCurrent += bytes;
+    totalPeak = max(totalPeak, totalCurrent);
+
+    return block;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Frees a block from allocBlock and removes it from the memory accounting
+ *
+ * @param[in] block - start of the block
+ *
+ *****************************************************************************/
+static void freeBlock(char* block)
+{
+    planeBlock* header = (planeBlock*)block;
+
+    if (block == nullptr) return;
+
+    currentBytes[header->type] -= header->bytes;
+    totalCurrent -= header->bytes;
+
+    switch (header->pages)
+    {
+#ifdef __linux__
+    case(HUGETLB_PAGES):
+        munmap(block, header->mapped);
+        break;
+    case(TRANSPARENT_HUGE_PAGES):
+        free(block);
+        break;
+#endif
+    default:
+        delete[] block;
+        break;
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Dynamically allocates a 2D pixel array. The pixels are one contiguous
+ * block with every row starting on a ROW_ALIGN boundary, rowStride(cols)
+ * bytes after the previous one. The block itself is kept just in front of
+ * the row pointers so free2D can release it.
+ *
+ * @param[in] rows - number of rows in the image
+ * @param[in] cols - number of columns in the image
+ *
+ * @returns returns the pointer to the 2D array
+ *
+ *****************************************************************************/
 pixel** alloc2D(int rows, int cols)
 {
     pixel** pptr = nullptr;
-    int i;
+    char* block;
+    char* data;
+    int i, stride = rowStride(cols);
 
-    pptr = new (nothrow) pixel * [rows];
+    pptr = new (nothrow) pixel * [rows + 1];
     if (pptr == nullptr)
     {
         cout << "Not enough memory to run program." << endl;
-        free2D(pptr, rows);
         exit(1);
     }
 
+    block = allocBlock((size_t)rows * stride, (rows + 1) * sizeof(pixel*),
+        PIXEL_PLANE, data);
+
+    pptr[0] = (pixel*)block;
+    pptr++;
     for (i = 0; i < rows; i++)
     {
-        pptr[i] = new (nothrow) pixel[cols];
-        if (pptr[i] == nullptr)
-        {
-            cout << "Not enough memory to run program" << endl;
-            free2D(pptr, rows);
-            exit(1);
-        }
+        pptr[i] = (pixel*)data + (size_t)i * stride;
     }
 
     return pptr;
@@ -50,24 +296,108 @@ pixel** alloc2D(int rows, int cols)
  * @author Adam Kraus
  *
  * @par Description:
- * Frees memory from a dynamically allocated 2D pixel array
+ * Frees memory from a dynamically allocated 2D pixel array. The number of
+ * rows is not needed since the array is one block.
  *
  * @param[in] ptr - pointer to the 2D array
- * @param[in] rows - number rows in the image
  *
  *****************************************************************************/
-void free2D(pixel**& ptr, int rows)
+void free2D(pixel**& ptr, int)
 {
+    if (ptr == nullptr) return;
+
+    // step back to the block stored in front of the row pointers
+    ptr--;
+    freeBlock((char*)ptr[0]);
+    delete[] ptr;
+    ptr = nullptr;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a view of a rectangle inside a 2D pixel array. The view has its own
+ * row pointers but shares the pixels, so changes to it show up in the
+ * original array. Freeing it with free2D only frees the row pointers.
+ *
+ * @param[in] ptr - pointer to the 2D array being viewed
+ * @param[in] row - first row of the rectangle
+ * @param[in] col - first column of the rectangle
+ * @param[in] rows - number of rows in the rectangle
+ *
+ * @returns returns the pointer to the 2D view
+ *
+ *****************************************************************************/
+pixel** view2D(pixel** ptr, int row, int col, int rows)
+{
+    pixel** pptr = nullptr;
     int i;
 
-    if (ptr == nullptr) return;
+    if (ptr == nullptr) return nullptr;
+
+    pptr = new (nothrow) pixel * [rows + 1];
+    if (pptr == nullptr)
+    {
+        cout << "Not enough memory to run program." << endl;
+        exit(1);
+    }
 
+    // a view owns no block of pixels
+    pptr[0] = nullptr;
+    pptr++;
     for (i = 0; i < rows; i++)
     {
-        delete[] ptr[i];
+        pptr[i] = ptr[row + i] + col;
     }
 
-    delete[] ptr;
+    return pptr;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates an image structure viewing a rectangle of another image. Any image
+ * operation can be given the view to alter just that rectangle.
+ *
+ * @param[in] img - image structure being viewed
+ * @param[in] row - first row of the rectangle
+ * @param[in] col - first column of the rectangle
+ * @param[in] rows - number of rows in the rectangle
+ * @param[in] cols - number of columns in the rectangle
+ *
+ * @returns returns the image structure of the view
+ *
+ *****************************************************************************/
+image imageView(image& img, int row, int col, int rows, int cols)
+{
+    image view;
+
+    view.rows = rows;
+    view.cols = cols;
+    view.redgray = view2D(img.redgray, row, col, rows);
+    view.green = view2D(img.green, row, col, rows);
+    view.blue = view2D(img.blue, row, col, rows);
+
+    return view;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Frees the colorbands of an image structure, whether it owns them or is a
+ * view of another image
+ *
+ * @param[in,out] img - image structure
+ *
+ *****************************************************************************/
+void freeImage(image& img)
+{
+    free2D(img.redgray, img.rows);
+    free2D(img.green, img.rows);
+    free2D(img.blue, img.rows);
 }
 
 /** ***************************************************************************
@@ -96,39 +426,40 @@ void copy2D(pixel**& src, pixel**& dest, int rows, int cols)
 }
 
 /** ***************************************************************************
-  * @author Adam Kraus
-  *
-  * @par Description:
-  * Dynamically allocates a 2D integer array
-  *
-  * @param[in] rows - number of rows in the image
-  * @param[in] cols - number of columns in the image
-  *
-  * @returns returns the pointer to the 2D array
-  *
-  *****************************************************************************/
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Dynamically allocates a 2D integer array as one contiguous block, laid
+ * out the same way as alloc2D
+ *
+ * @param[in] rows - number of rows in the image
+ * @param[in] cols - number of columns in the image
+ *
+ * @returns returns the pointer to the 2D array
+ *
+ *****************************************************************************/
 int** alloc2DInt(int rows, int cols)
 {
     int** iptr = nullptr;
+    char* block;
+    char* data;
     int i;
 
-    iptr = new (nothrow) int* [rows];
+    iptr = new (nothrow) int* [rows + 1];
     if (iptr == nullptr)
     {
         cout << "Not enough memory to run program." << endl;
-        free2DInt(iptr, rows);
         exit(1);
     }
 
+    block = allocBlock((size_t)rows * cols * sizeof(int),
+        (rows + 1) * sizeof(int*), INT_PLANE, data);
+
+    iptr[0] = (int*)block;
+    iptr++;
     for (i = 0; i < rows; i++)
     {
-        iptr[i] = new (nothrow) int[cols];
-        if (iptr[i] == nullptr)
-        {
-            cout << "Not enough memory to run program" << endl;
-            free2DInt(iptr, rows);
-            exit(1);
-        }
+        iptr[i] = (int*)data + (size_t)i * cols;
     }
 
     return iptr;
@@ -138,22 +469,348 @@ int** alloc2DInt(int rows, int cols)
  * @author Adam Kraus
  *
  * @par Description:
- * Frees memory from a dynamically allocated 2D integer array
+ * Frees memory from a dynamically allocated 2D integer array. The number of
+ * rows is not needed since the array is one block.
  *
  * @param[in] ptr - pointer to the 2D array
- * @param[in] rows - number rows in the image
  *
  *****************************************************************************/
-void free2DInt(int**& ptr, int rows)
+void free2DInt(int**& ptr, int)
 {
-    int i;
-
     if (ptr == nullptr) return;
 
+    ptr--;
+    freeBlock((char*)ptr[0]);
+    delete[] ptr;
+    ptr = nullptr;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Dynamically allocates a 2D array of sums or grid cells as one contiguous
+ * block, laid out the same way as alloc2D with every row starting on a
+ * ROW_ALIGN boundary
+ *
+ * @param[out] ptr - pointer to the 2D array
+ * @param[in] rows - number of rows in the array
+ * @param[in] cols - number of columns in the array
+ * @param[in] type - kind of array, for the memory accounting
+ *
+ *****************************************************************************/
+template <class T>
+static void allocWords(T**& ptr, int rows, int cols, planeType type)
+{
+    char* block;
+    char* data;
+    int i, stride = sumStride(cols, sizeof(T));
+
+    ptr = new (nothrow) T * [rows + 1];
+    if (ptr == nullptr)
+    {
+        cout << "Not enough memory to run program." << endl;
+        exit(1);
+    }
+
+    block = allocBlock((size_t)rows * stride * sizeof(T),
+        (rows + 1) * sizeof(T*), type, data);
+
+    ptr[0] = (T*)block;
+    ptr++;
     for (i = 0; i < rows; i++)
     {
-        delete[] ptr[i];
+        ptr[i] = (T*)data + (size_t)i * stride;
     }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Frees memory from a dynamically allocated 2D array of sums or grid cells
+ *
+ * @param[in] ptr - pointer to the 2D array
+ *
+ *****************************************************************************/
+template <class T>
+static void freeWords(T**& ptr)
+{
+    if (ptr == nullptr) return;
 
+    ptr--;
+    freeBlock((char*)ptr[0]);
     delete[] ptr;
-}
\ No newline at end of file
+    ptr = nullptr;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the entries from the start of one row of a 2D array of sums to the
+ * start of the next, a whole number of ROW_ALIGN blocks
+ *
+ * @param[in] cols - number of columns in the array
+ * @param[in] wordBytes - bytes in each sum
+ *
+ * @returns returns the entries per row
+ *
+ *****************************************************************************/
+int sumStride(int cols, size_t wordBytes)
+{
+    int perBlock = ROW_ALIGN / (int)wordBytes;
+
+    return (cols + perBlock - 1) / perBlock * perBlock;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Dynamically allocates a 2D array of 32 bit sums
+ *
+ * @param[out] ptr - pointer to the 2D array
+ * @param[in] rows - number of rows in the array
+ * @param[in] cols - number of columns in the array
+ *
+ *****************************************************************************/
+void alloc2DSum(uint32_t**& ptr, int rows, int cols)
+{
+    allocWords(ptr, rows, cols, SUM_PLANE);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Dynamically allocates a 2D array of 64 bit sums
+ *
+ * @param[out] ptr - pointer to the 2D array
+ * @param[in] rows - number of rows in the array
+ * @param[in] cols - number of columns in the array
+ *
+ *****************************************************************************/
+void alloc2DSum(uint64_t**& ptr, int rows, int cols)
+{
+    allocWords(ptr, rows, cols, SUM_PLANE);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Frees memory from a dynamically allocated 2D array of 32 bit sums
+ *
+ * @param[in] ptr - pointer to the 2D array
+ *
+ *****************************************************************************/
+void free2DSum(uint32_t**& ptr)
+{
+    freeWords(ptr);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Frees memory from a dynamically allocated 2D array of 64 bit sums
+ *
+ * @param[in] ptr - pointer to the 2D array
+ *
+ *****************************************************************************/
+void free2DSum(uint64_t**& ptr)
+{
+    freeWords(ptr);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Predicts the bytes alloc2DSum uses for an array, including the row
+ * pointers and block header
+ *
+ * @param[in] rows - number of rows in the array
+ * @param[in] cols - number of columns in the array
+ * @param[in] wordBytes - bytes in each sum
+ *
+ * @returns returns the predicted bytes
+ *
+ *****************************************************************************/
+size_t sumBytes(int rows, int cols, size_t wordBytes)
+{
+    return sizeof(planeBlock) + ROW_ALIGN
+        + (size_t)rows * sumStride(cols, wordBytes) * wordBytes
+        + (rows + 1) * sizeof(void*);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Dynamically allocates a 2D array of bilateral grid cells, laid out the
+ * same way as alloc2DSum, sumStride(cols, sizeof(float)) floats apart
+ *
+ * @param[in] rows - number of rows in the array
+ * @param[in] cols - number of columns in the array
+ *
+ * @returns returns the pointer to the 2D array
+ *
+ *****************************************************************************/
+float** alloc2DGrid(int rows, int cols)
+{
+    float** ptr;
+
+    allocWords(ptr, rows, cols, GRID_PLANE);
+
+    return ptr;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Frees memory from a dynamically allocated 2D array of grid cells
+ *
+ * @param[in] ptr - pointer to the 2D array
+ *
+ *****************************************************************************/
+void free2DGrid(float**& ptr)
+{
+    freeWords(ptr);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets the most memory the 2D arrays may use at once. Allocations that would
+ * go over it end the program.
+ *
+ * @param[in] bytes - memory limit in bytes, 0 for no limit
+ *
+ *****************************************************************************/
+void setMemoryLimit(size_t bytes)
+{
+    memoryLimit = bytes;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Gets the memory limit set by setMemoryLimit
+ *
+ * @returns returns the memory limit in bytes, 0 for no limit
+ *
+ *****************************************************************************/
+size_t getMemoryLimit()
+{
+    return memoryLimit;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Predicts the bytes alloc2D uses for an array, including the row pointers
+ * and block header
+ *
+ * @param[in] rows - number of rows in the image
+ * @param[in] cols - number of columns in the image
+ *
+ * @returns returns the predicted bytes
+ *
+ *****************************************************************************/
+size_t planeBytes(int rows, int cols)
+{
+    return sizeof(planeBlock) + ROW_ALIGN + (size_t)rows * rowStride(cols)
+        + (rows + 1) * sizeof(pixel*);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Outputs the current and peak memory used by each type of 2D array
+ *
+ * @param[out] out - stream to output to
+ *
+ *****************************************************************************/
+void memoryReport(ostream& out)
+{
+    out << "Pixel planes: " << currentBytes[PIXEL_PLANE] << " bytes current, "
+        << peakBytes[PIXEL_PLANE] << " bytes peak" << endl;
+    out << "Int planes:   " << currentBytes[INT_PLANE] << " bytes current, "
+        << peakBytes[INT_PLANE] << " bytes peak" << endl;
+    out << "Sum tables:   " << currentBytes[SUM_PLANE] << " bytes current, "
+        << peakBytes[SUM_PLANE] << " bytes peak" << endl;
+    out << "Grid cells:   " << currentBytes[GRID_PLANE] << " bytes current, "
+        << peakBytes[GRID_PLANE] << " bytes peak" << endl;
+    out << "Total:        " << totalCurrent << " bytes current, "
+        << totalPeak << " bytes peak" << endl;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Predicts the most memory an option uses at once on an image, counting the
+ * three colorbands of the image, the temporary arrays of the operation and
+ * the scratch buffers each thread keeps that grow with the image. Buffers
+ * of a few rows, such as stencil tile copies and pipeline rows, are left
+ * out.
+ *
+ * @param[in] settings - option applied to the image and its values
+ * @param[in] rows - number of rows in the image
+ * @param[in] cols - number of columns in the image
+ *
+ * @returns returns the predicted bytes
+ *
+ *****************************************************************************/
+size_t predictFootprint(const optionSettings& settings, int rows, int cols)
+{
+    int scale = settings.scaleNum, threads = threadCount(rows);
+    size_t plane = planeBytes(rows, cols), scaled, padded;
+    int newRows, newCols;
+
+    switch (settings.option)
+    {
+    case(EDGE):
+        // color image, gradient band and an int array of gradient angles
+        return 8 * plane;
+    case(GAUSS):
+        // three bands, an int array of the values between the passes and a
+        // causal pass down a strip of columns for each thread
+        return 7 * plane + (size_t)threads * rows * GAUSS_STRIP * sizeof(double);
+    case(MEDIAN):
+        // three bands, a band of medians and for each thread a ring of rows
+        // and the column histograms
+        padded = (size_t)cols + 2 * settings.radius;
+        return 4 * plane + threads * padded
+            * (2 * settings.radius + 2 + 272 * sizeof(uint16_t));
+    case(ERODE):
+    case(DILATE):
+    case(OPEN):
+    case(CLOSE):
+        // three bands, a band between the vertical and horizontal passes and
+        // two blocks of running extremes for each thread
+        return 4 * plane + (size_t)threads * 2 * settings.elemRows * cols;
+    case(THRESHOLD):
+        // three bands and the sums and squares of one band
+        return 3 * plane + summedAreaBytes(rows, cols, true);
+    case(BILATERAL):
+        // three bands and a strip of the bilateral grid
+        return 3 * plane + bilateralBytes(rows, cols, settings.sigma,
+            settings.rangeSigma);
+    case(SCALE):
+        if (scale < 50 || scale > 200 || scale == 100) return 3 * plane;
+        newRows = int(rows * (scale / 100.0));
+        newCols = int(cols * (scale / 100.0));
+        scaled = planeBytes(newRows, newCols);
+        return 3 * plane + 3 * scaled;
+    default:
+        return 3 * plane;
+    }
+}
@@ -7,9 +7,14 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <vector>
+#include <thread>
+#include <functional>
 
 using namespace std;
 #ifndef __NETPBM__H__
@@ -28,8 +33,35 @@ enum imageOption{NEGATE, /**< Negate color values        */
             SMOOTH,      /**< Smooth image               */
             GRAYSCALE,   /**< Convert image to grayscale */
             CONTRAST,    /**< Increase image contrast    */
+            EQUALIZE,    /**< Equalize image histogram   */
             SCALE,       /**< Scale image                */
-            EDGE         /**< Detect edges               */
+            EDGE,        /**< Detect edges               */
+            CONVERT,     /**< Convert color space        */
+            CHAIN,       /**< Chain of point operations  */
+            GAUSS,       /**< Gaussian blur              */
+            MEDIAN,      /**< Median filter              */
+            ERODE,       /**< Erosion by a rectangle     */
+            DILATE,      /**< Dilation by a rectangle    */
+            OPEN,        /**< Opening by a rectangle     */
+            CLOSE,       /**< Closing by a rectangle     */
+            THRESHOLD,   /**< Local adaptive threshold   */
+            BILATERAL    /**< Bilateral filter           */
+};
+
+/**
+ * @brief Color spaces the three colorbands of an image can hold
+ */
+enum colorSpace{RGB_SPACE, /**< Red, green, blue                */
+            YCBCR_SPACE,   /**< Luma, blue and red differences */
+            HSV_SPACE      /**< Hue, saturation, value         */
+};
+
+/**
+ * @brief Command line supplied part of the image to alter
+ */
+enum regionMode{WHOLE, /**< Alter and output the whole image             */
+            INPLACE,   /**< Alter a region, output the whole image       */
+            CROP       /**< Alter a region, output only that region      */
 };
 
 /**
@@ -39,6 +71,53 @@ enum outputMode{ASCII, /**< Output as ASCII  */
             BINARY     /**< Output as Binary */
 };
 
+/**
+ * @brief SIMD instruction sets the colorband kernels can use
+ */
+enum simdLevel{SIMD_SCALAR, /**< No SIMD instructions */
+            SIMD_SSE2,      /**< 128-bit SSE2        */
+            SIMD_AVX2       /**< 256-bit AVX2        */
+};
+
+/**
+ * @brief Kinds of 2D arrays tracked by the memory accounting
+ */
+enum planeType{PIXEL_PLANE, /**< Arrays from alloc2D    */
+            INT_PLANE,      /**< Arrays from alloc2DInt */
+            SUM_PLANE,      /**< Arrays from alloc2DSum */
+            GRID_PLANE,     /**< Arrays from alloc2DGrid */
+            PLANE_TYPES     /**< Number of array kinds  */
+};
+
+/**
+ * @brief Kinds of pages backing large 2D arrays
+ */
+enum pageMode{NORMAL_PAGES,          /**< Normal pages from new           */
+            TRANSPARENT_HUGE_PAGES,  /**< Aligned, advised for huge pages */
+            HUGETLB_PAGES            /**< Reserved hugetlbfs pages        */
+};
+
+/**
+ * @brief How stencils treat pixels whose neighborhood leaves the image
+ */
+enum borderMode{BLACK_BORDER,  /**< Set the edge pixels to 0             */
+            ZERO_BORDER,       /**< Read 0 outside the image             */
+            CLAMP_BORDER,      /**< Repeat the edge pixels               */
+            MIRROR_BORDER,     /**< Reflect about the edge pixels        */
+            WRAP_BORDER        /**< Read from the other side of the image */
+};
+
+/**
+ * @brief Header at the start of the memory block behind every 2D array
+ */
+struct planeBlock
+{
+    size_t bytes;   /**< Bytes used by the array, including row pointers */
+    size_t mapped;  /**< Bytes in the block itself */
+    planeType type; /**< Kind of array using the block */
+    pageMode pages; /**< Kind of pages backing the block */
+};
+
 /**
  * @brief Holds data about an image
  */
@@ -51,6 +130,104 @@ struct image
     pixel** blue;    /**< 2D array for blue color values */
 };
 
+/**
+ * @brief One stage of a line buffered pipeline of stencils. The first stage
+ * of a pipeline has no input and makes rows from nothing.
+ */
+struct lineStage
+{
+    int halo;     /**< Rows and columns the stage reaches out on each side */
+    int channels; /**< Number of colorbands the stage outputs */
+    /**
+     * @brief Sets row i of each output colorband, out[c][j] for every column
+     * j. in[c][q] is row i + q of input colorband c for q from -halo to halo,
+     * readable halo columns past each side.
+     */
+    function<void(int i, pixel** const* in, pixel* const* out, int cols)> row;
+};
+
+/**
+ * @brief New color value for each old color value of a point operation
+ */
+struct pointTable
+{
+    pixel value[256]; /**< New color value, indexed by old color value */
+};
+
+/**
+ * @brief Point operations chained on the command line, folded into a table
+ * for the colorbands and a table for the gray value
+ */
+struct pointChain
+{
+    pointTable before; /**< Operations on each colorband before grayscale */
+    bool gray;         /**< Converts to grayscale */
+    pointTable after;  /**< Operations on the gray value after grayscale */
+    int steps;         /**< Number of operations chained */
+};
+
+/**
+ * @brief Command line supplied option and the values that go with it
+ */
+struct optionSettings
+{
+    imageOption option; /**< Option to apply */
+    int briNum;         /**< Value to brighten by */
+    int scaleNum;       /**< Percent to scale by */
+    int radius;         /**< Radius of the smoothing, median or threshold box */
+    double sigma;       /**< Standard deviation of the Gaussian or bilateral blur */
+    double rangeSigma;  /**< Standard deviation in color value of the bilateral */
+    int elemRows;       /**< Rows in the rectangle of a morphology option */
+    int elemCols;       /**< Columns in the rectangle of a morphology option */
+    double clip;        /**< Percent of pixels contrast clips at each end */
+    colorSpace from;    /**< Color space of the input image */
+    colorSpace to;      /**< Color space of the output image */
+    bool luma;          /**< Sharpen and smooth only the luma of the image */
+    pointChain chain;   /**< Point operations to apply in one pass */
+};
+
+/**
+ * @brief Number of sub-histograms in a band counter
+ */
+const int HIST_LANES = 8;
+
+/**
+ * @brief Counts of each color value in one colorband, split over several
+ * 32 bit sub-histograms so repeated values do not stall on each other. The
+ * sub-histograms are moved into the totals before they could overflow.
+ */
+struct bandCounter
+{
+    uint32_t bins[HIST_LANES][256]; /**< Sub-histograms, added together for the counts */
+    size_t totals[256];             /**< Counts moved out of the sub-histograms */
+    size_t pending;                 /**< Values counted in the sub-histograms */
+};
+
+/**
+ * @brief Counts of each color value in each colorband of an image
+ */
+struct histogram
+{
+    int channels;         /**< Number of colorbands counted */
+    size_t pixels;        /**< Number of pixels counted in each colorband */
+    size_t count[3][256]; /**< Count of each value in each colorband */
+};
+
+/**
+ * @brief Summed-area table of a colorband. Entry [i][j] is the sum of the
+ * color values above row i and left of column j, so row 0 and column 0 are
+ * 0. Each table uses 32 bit sums if its total fits, 64 bit sums if not.
+ */
+struct summedArea
+{
+    int rows;            /**< Rows in the colorband summed */
+    int cols;            /**< Columns in the colorband summed */
+    uint32_t** sum32;    /**< 32 bit sums of the color values, or nullptr */
+    uint64_t** sum64;    /**< 64 bit sums of the color values, or nullptr */
+    uint32_t** square32; /**< 32 bit sums of their squares, or nullptr */
+    uint64_t** square64; /**< 64 bit sums of their squares, or nullptr */
+};
+
 /**
  * @brief Magic Number of P2
  */
@@ -67,6 +244,141 @@ const string P5 = "P5";
  * @brief Magic Number of P6
  */
 const string P6 = "P6";
+/**
+ * @brief Byte alignment of the start of every row in a pixel array
+ */
+const int ROW_ALIGN = 64;
+/**
+ * @brief Row strides that are a multiple of this many bytes get padded
+ */
+const int ALIAS_STRIDE = 512;
+/**
+ * @brief Bytes in a megabyte
+ */
+const size_t MEGABYTE = 1024 * 1024;
+/**
+ * @brief Bytes in a huge page, arrays at least this big may use huge pages
+ */
+const size_t HUGE_PAGE = 2 * MEGABYTE;
+/**
+ * @brief 2^16 / 10 rounded up, multiplying by it and shifting right 16 bits
+ * divides numbers up to 2560 by 10
+ */
+const int GRAY_RECIP = 6554;
+/**
+ * @brief Largest radius of the smoothing box
+ */
+const int MAX_RADIUS = 500;
+/**
+ * @brief Fraction bits of the reciprocal the smoothing box divides by, enough
+ * for an exact quotient of any box up to MAX_RADIUS
+ */
+const int BOX_SHIFT = 48;
+/**
+ * @brief Largest radius of the median box, the box's histogram counts fit
+ * in 16 bits
+ */
+const int MAX_MEDIAN = 100;
+/**
+ * @brief Most rows or columns in the rectangle of a morphology option
+ */
+const int MAX_ELEMENT = 1001;
+/**
+ * @brief Largest radius of the window of the local threshold
+ */
+const int MAX_THRESHOLD = 1000;
+/**
+ * @brief How far a low standard deviation pulls the local threshold below
+ * the local mean, Sauvola's k
+ */
+const double SAUVOLA_K = 0.2;
+/**
+ * @brief Standard deviation at which the local threshold is the local mean,
+ * Sauvola's R
+ */
+const double SAUVOLA_RANGE = 128;
+/**
+ * @brief Smallest standard deviation in pixels of the bilateral filter
+ */
+const double MIN_SPACE_SIGMA = 2;
+/**
+ * @brief Largest standard deviation in pixels of the bilateral filter
+ */
+const double MAX_SPACE_SIGMA = 100;
+/**
+ * @brief Smallest standard deviation in color value of the bilateral filter
+ */
+const double MIN_RANGE_SIGMA = 4;
+/**
+ * @brief Largest standard deviation in color value of the bilateral filter
+ */
+const double MAX_RANGE_SIGMA = 255;
+/**
+ * @brief Empty cells of the bilateral grid on each side, as far as its
+ * 5 tap blur reaches
+ */
+const int GRID_PAD = 2;
+/**
+ * @brief Most bytes of finished bilateral grid cells held at once, the grid
+ * is worked through in strips of rows this size
+ */
+const size_t GRID_STRIP_BYTES = 64 * MEGABYTE;
+/**
+ * @brief Smallest standard deviation of the Gaussian blur
+ */
+const double MIN_SIGMA = 0.5;
+/**
+ * @brief Largest standard deviation of the Gaussian blur
+ */
+const double MAX_SIGMA = 50;
+/**
+ * @brief Columns the vertical pass of the Gaussian blur filters together, a
+ * row of them as doubles is eight 64 byte cache lines
+ */
+const int GAUSS_STRIP = 64;
+/**
+ * @brief Fraction bits of the color values kept between the passes of the
+ * Gaussian blur
+ */
+const int GAUSS_SHIFT = 8;
+/**
+ * @brief Rows in a stencil tile unless set with --tile
+ */
+const int TILE_ROWS = 64;
+/**
+ * @brief Columns in a stencil tile unless set with --tile, three colorbands
+ * of a tile and its halo fit in a 256 KB L2 cache
+ */
+const int TILE_COLS = 512;
+/**
+ * @brief Fewest rows worth giving a thread of its own
+ */
+const int MIN_THREAD_ROWS = 64;
+/**
+ * @brief Fraction bits of the fixed point YCbCr weights
+ */
+const int YCC_SHIFT = 14;
+/**
+ * @brief 1 in YCbCr fixed point
+ */
+const int YCC_ONE = 1 << YCC_SHIFT;
+/**
+ * @brief 0.5 in YCbCr fixed point, added to round
+ */
+const int YCC_HALF = 1 << (YCC_SHIFT - 1);
+const int Y_R = 4899;   /**< 0.299 red weight of luma */
+const int Y_G = 9617;   /**< 0.587 green weight of luma */
+const int Y_B = 1868;   /**< 0.114 blue weight of luma */
+const int CB_R = 2765;  /**< -0.168736 red weight of blue difference */
+const int CB_G = 5427;  /**< -0.331264 green weight of blue difference */
+const int CB_B = 8192;  /**< 0.5 blue weight of blue difference */
+const int CR_R = 8192;  /**< 0.5 red weight of red difference */
+const int CR_G = 6860;  /**< -0.418688 green weight of red difference */
+const int CR_B = 1332;  /**< -0.081312 blue weight of red difference */
+const int R_CR = 22970; /**< 1.402 red difference weight of red */
+const int G_CB = 5638;  /**< -0.344136 blue difference weight of green */
+const int G_CR = 11700; /**< -0.714136 red difference weight of green */
+const int B_CB = 29032; /**< 1.772 blue difference weight of blue */
 /**
  * @brief PI
  */
@@ -79,29 +391,115 @@ void closeFileOut(ofstream& file);
 void readHeader(ifstream& file, string& magicNum, vector<string>& comments, int& rows, int& cols, int& maxVal);
 void readASCII(ifstream& file, image& img);
 void readBIN(ifstream& file, image& img);
+void readBINChain(ifstream& file, image& img, const pointChain& chain);
 void writeHeader(ofstream& file, string magicNum, vector<string>& comments, int rows, int cols, int maxVal);
 void writeASCII(ofstream& file, image& img);
 void writeBIN(ofstream& file, image& img);
+void setStridePadding(int bytes);
+int rowStride(int cols);
 pixel** alloc2D(int rows, int cols);
 void free2D(pixel**& ptr, int rows);
+pixel** view2D(pixel** ptr, int row, int col, int rows);
+image imageView(image& img, int row, int col, int rows, int cols);
+void freeImage(image& img);
 void copy2D(pixel**& ptr1, pixel**& ptr2, int rows, int cols);
 int** alloc2DInt(int rows, int cols);
 void free2DInt(int**& ptr, int rows);
+void setPageMode(pageMode mode);
+void setMemoryLimit(size_t bytes);
+size_t getMemoryLimit();
+size_t planeBytes(int rows, int cols);
+void memoryReport(ostream& out);
+int sumStride(int cols, size_t wordBytes);
+void alloc2DSum(uint32_t**& ptr, int rows, int cols);
+void alloc2DSum(uint64_t**& ptr, int rows, int cols);
+void free2DSum(uint32_t**& ptr);
+void free2DSum(uint64_t**& ptr);
+size_t sumBytes(int rows, int cols, size_t wordBytes);
+float** alloc2DGrid(int rows, int cols);
+void free2DGrid(float**& ptr);
+size_t predictFootprint(const optionSettings& settings, int rows, int cols);
+void clearCounter(bandCounter& counter);
+void countRow(bandCounter& counter, const pixel* row, int cols);
+void addCounter(const bandCounter& counter, histogram& hist, int channel);
+histogram emptyHistogram(int channels, size_t pixels);
+histogram imageHistogram(image& img);
+histogram imageHistogram(image& img, int channels, const function<void(int)>& prepare);
+void cumulativeCounts(const histogram& hist, int channel, size_t cdf[256]);
+int histogramPercentile(const histogram& hist, int channel, double percent);
+summedArea buildSummedArea(pixel** colorband, int rows, int cols, bool squares);
+void freeSummedArea(summedArea& table);
+uint64_t areaSum(const summedArea& table, int top, int left, int bottom,
+    int right);
+uint64_t areaSquares(const summedArea& table, int top, int left, int bottom,
+    int right);
+size_t summedAreaBytes(int rows, int cols, bool squares);
+void rgbToYCbCr(image& img);
+void yCbCrToRGB(image& img);
+void rgbToHSV(image& img);
+void hsvToRGB(image& img);
+void convertColorSpace(image& img, colorSpace from, colorSpace to);
+pointTable identityTable();
+pointTable negateTable();
+pointTable brightenTable(int value);
+pointTable stretchTable(int min, int max);
+pointTable equalizeTable(const histogram& hist, int channel);
+pointTable composeTables(const pointTable& first, const pointTable& second);
+void applyTable(pixel** colorband, int rows, int cols, const pointTable& table);
+void applyTable(image& img, const pointTable& table);
+pointChain emptyChain();
+void chainTable(pointChain& chain, const pointTable& table);
+void chainGray(pointChain& chain);
+simdLevel detectSimd();
+void negateBand(pixel** colorband, int rows, int cols);
+void brightenBand(pixel** colorband, int rows, int cols, int value);
+void grayscaleBands(pixel** red, pixel** green, pixel** blue, pixel** gray,
+    int rows, int cols);
+void extremeRow(pixel* out, const pixel* a, const pixel* b, int cols,
+    bool maximum);
+void prefixRow(uint32_t* out, const uint32_t* above, const pixel* row,
+    int cols, bool squares);
 void imageNegate(image& img);
 void imageBrighten(image& img, int value);
 void imageSharpen(image& img);
-void imageSmooth(image& img);
+void imageSmooth(image& img, int radius);
+void imageGaussian(image& img, double sigma);
+void imageMedian(image& img, int radius);
+void imageErode(image& img, int elemRows, int elemCols);
+void imageDilate(image& img, int elemRows, int elemCols);
+void imageOpen(image& img, int elemRows, int elemCols);
+void imageClose(image& img, int elemRows, int elemCols);
+void imageThreshold(image& img, int radius);
+void imageBilateral(image& img, double spaceSigma, double rangeSigma);
+size_t bilateralBytes(int rows, int cols, double spaceSigma, double rangeSigma);
 void imageGrayscale(image& img);
-void imageContrast(image& img);
+void imagePointChain(image& img, const pointChain& chain);
+histogram grayscaleHistogram(image& img);
+void imageContrast(image& img, double clip);
+void imageEqualize(image& img);
 void imageScale(image& img, int scale);
 void imageEdgeDetection(image& img);
-int sobelX(image& img, int i, int j);
-int sobelY(image& img, int i, int j);
 int cropNum(int num);
-void getSurrSha(pixel**& colorband, int& b, int& d, int& f, int& h, int iPos, int jPos);
-void getSurrSmo(pixel**& colorband, int& a, int& b, int& c, int& d, int& f, int& g, int& h, int& i, int iPos, int jPos);
 int mapNum(int num, double lower1, double upper1, double lower2, double upper2);
 int roundAngle(double angle);
 bool inBetween(double num, double lower, double upper);
+int imageChannels(const image& img);
+void setTileSize(int rows, int cols);
+void setBorderMode(borderMode mode);
+borderMode getBorderMode();
+void borderRow(pixel* to, pixel** colorband, int i, int first, int count,
+    int rows, int cols);
+void tileStencil(image& img, int halo, const function<void(pixel** in,
+    pixel** out, int rows, int cols)>& stencil);
+void linePipeline(const vector<lineStage>& stages, pixel** const* dest,
+    int rows, int cols);
+int threadCount(int rows);
+void parallelRows(int rows, int threads, const function<void(int, int, int)>& work);
+colorSpace parseColorSpace(const char* name);
+bool isPointOption(imageOption option);
+void printUsage();
+void applyOption(image& img, const optionSettings& settings);
+void streamOption(ifstream& fin, ofstream& fout, bool asciiIn, outputMode mode,
+    int rows, int cols, const optionSettings& settings);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,324 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief Expression templates for point operations. Arithmetic on
+ * colorbands builds a tree of small structures at compile time instead of
+ * computing anything, and evaluate() runs the whole tree in one pass over
+ * the pixels. Chained operations make no temporary colorbands, and the
+ * compiler sees the whole operation to specialize, such as
+ * "evaluate(band, rows, cols, clampPixel(255 - colorBand(band) + 40))".
+ ****************************************************************************/
+
+#ifndef __PIXELEXPR__H__
+#define __PIXELEXPR__H__
+
+#include "netPBM.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Computes the gray value of a color exactly halfway between two integers
+ * the way the original double precision formula does. Its rounding errors
+ * push some halves down and some up, and they follow no integer rule, so
+ * the same double operations are done. The value is in [0, 255], where
+ * adding 0.5 can only round up to a whole number it had already reached,
+ * so truncating the sum rounds exactly as round does, without calling it.
+ *
+ * @param[in] r - red color value
+ * @param[in] g - green color value
+ * @param[in] b - blue color value
+ *
+ * @returns returns the gray value
+ *
+ *****************************************************************************/
+inline pixel grayTie(int r, int g, int b)
+{
+    return (pixel)(int)(0.3 * r + 0.6 * g + 0.1 * b + 0.5);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the gray value of a red, green and blue color value, rounded
+ * exactly as grayscaleBands rounds it. Both roundings are found and one is
+ * picked with a mask, so loops over pixels have no branch and can be
+ * vectorized.
+ *
+ * @param[in] r - red color value
+ * @param[in] g - green color value
+ * @param[in] b - blue color value
+ *
+ * @returns returns the gray value
+ *
+ *****************************************************************************/
+inline pixel grayValue(int r, int g, int b)
+{
+    int sum = 3 * r + 6 * g + b;
+    int rounded = ((sum + 5) * GRAY_RECIP) >> 16;
+    int halfway = -(int)(sum % 10 == 5);
+
+    // halfway values round as the double weights do
+    return (pixel)(rounded + ((grayTie(r, g, b) - rounded) & halfway));
+}
+
+/**
+ * @brief Base of every pixel expression, so operators only match expressions
+ */
+template <class E>
+struct pixelExpr
+{
+    /**
+     * @brief The expression as its real type
+     */
+    const E& self() const
+    {
+        return static_cast<const E&>(*this);
+    }
+};
+
+/**
+ * @brief The color values of a colorband
+ */
+struct bandExpr : pixelExpr<bandExpr>
+{
+    pixel** band;     /**< Colorband read */
+    const pixel* row; /**< Row of the colorband being evaluated */
+
+    explicit bandExpr(pixel** colorband) : band(colorband), row(nullptr) {}
+    void bind(int i) { row = band[i]; }
+    int operator[](int j) const { return row[j]; }
+};
+
+/**
+ * @brief The same number at every pixel
+ */
+struct constExpr : pixelExpr<constExpr>
+{
+    int value; /**< The number */
+
+    explicit constExpr(int num) : value(num) {}
+    void bind(int) {}
+    int operator[](int) const { return value; }
+};
+
+/**
+ * @brief An operator applied to two expressions at each pixel
+ */
+template <class Op, class L, class R>
+struct binaryExpr : pixelExpr<binaryExpr<Op, L, R>>
+{
+    L left;  /**< Left operand */
+    R right; /**< Right operand */
+
+    binaryExpr(const L& l, const R& r) : left(l), right(r) {}
+    void bind(int i) { left.bind(i); right.bind(i); }
+    int operator[](int j) const { return Op::apply(left[j], right[j]); }
+};
+
+/**
+ * @brief A function applied to an expression at each pixel
+ */
+template <class Op, class E>
+struct unaryExpr : pixelExpr<unaryExpr<Op, E>>
+{
+    E arg; /**< Operand */
+
+    explicit unaryExpr(const E& e) : arg(e) {}
+    void bind(int i) { arg.bind(i); }
+    int operator[](int j) const { return Op::apply(arg[j]); }
+};
+
+/**
+ * @brief A point table looked up with an expression in [0, 255]
+ */
+template <class E>
+struct tableExpr : pixelExpr<tableExpr<E>>
+{
+    E arg;              /**< Index into the table */
+    const pixel* value; /**< New color values of the table */
+
+    tableExpr(const E& e, const pointTable& table) : arg(e), value(table.value) {}
+    void bind(int i) { arg.bind(i); }
+    int operator[](int j) const { return value[arg[j]]; }
+};
+
+/**
+ * @brief Gray value of three expressions for red, green and blue in
+ * [0, 255], rounded exactly as grayscaleBands rounds it
+ */
+template <class R, class G, class B>
+struct grayExpr : pixelExpr<grayExpr<R, G, B>>
+{
+    R red;   /**< Red color values */
+    G green; /**< Green color values */
+    B blue;  /**< Blue color values */
+
+    grayExpr(const R& r, const G& g, const B& b) : red(r), green(g), blue(b) {}
+    void bind(int i) { red.bind(i); green.bind(i); blue.bind(i); }
+    int operator[](int j) const { return grayValue(red[j], green[j], blue[j]); }
+};
+
+struct addOp { static int apply(int a, int b) { return a + b; } };   /**< a + b */
+struct subOp { static int apply(int a, int b) { return a - b; } };   /**< a - b */
+struct mulOp { static int apply(int a, int b) { return a * b; } };   /**< a * b */
+struct shiftOp { static int apply(int a, int b) { return a >> b; } }; /**< a >> b */
+struct minOp { static int apply(int a, int b) { return a < b ? a : b; } }; /**< min(a, b) */
+struct maxOp { static int apply(int a, int b) { return a > b ? a : b; } }; /**< max(a, b) */
+/**
+ * @brief Crops to [0, 255] without branches
+ */
+struct clampOp
+{
+    static int apply(int a)
+    {
+        a = a < 0 ? 0 : a;
+        return a > 255 ? 255 : a;
+    }
+};
+
+/**
+ * @brief Defines an operator or function of two expressions, or of an
+ * expression and a number
+ */
+#define PIXEL_EXPR_BINARY(name, Op)                                          \
+template <class L, class R>                                                  \
+binaryExpr<Op, L, R> name(const pixelExpr<L>& l, const pixelExpr<R>& r)      \
+{                                                                            \
+    return binaryExpr<Op, L, R>(l.self(), r.self());                         \
+}                                                                            \
+template <class L>                                                           \
+binaryExpr<Op, L, constExpr> name(const pixelExpr<L>& l, int r)              \
+{                                                                            \
+    return binaryExpr<Op, L, constExpr>(l.self(), constExpr(r));             \
+}                                                                            \
+template <class R>                                                           \
+binaryExpr<Op, constExpr, R> name(int l, const pixelExpr<R>& r)              \
+{                                                                            \
+    return binaryExpr<Op, constExpr, R>(constExpr(l), r.self());             \
+}
+
+PIXEL_EXPR_BINARY(operator+, addOp)
+PIXEL_EXPR_BINARY(operator-, subOp)
+PIXEL_EXPR_BINARY(operator*, mulOp)
+PIXEL_EXPR_BINARY(operator>>, shiftOp)
+PIXEL_EXPR_BINARY(minPixel, minOp)
+PIXEL_EXPR_BINARY(maxPixel, maxOp)
+
+#undef PIXEL_EXPR_BINARY
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes an expression of the color values of a colorband
+ *
+ * @param[in] colorband - the colorband
+ *
+ * @returns returns the expression
+ *
+ *****************************************************************************/
+inline bandExpr colorBand(pixel** colorband)
+{
+    return bandExpr(colorband);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes an expression that crops another to [0, 255]
+ *
+ * @param[in] e - expression to crop
+ *
+ * @returns returns the expression
+ *
+ *****************************************************************************/
+template <class E>
+unaryExpr<clampOp, E> clampPixel(const pixelExpr<E>& e)
+{
+    return unaryExpr<clampOp, E>(e.self());
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes an expression that looks another up in a point table
+ *
+ * @param[in] e - expression in [0, 255] to look up
+ * @param[in] table - table of new color values, must outlive the expression
+ *
+ * @returns returns the expression
+ *
+ *****************************************************************************/
+template <class E>
+tableExpr<E> lookup(const pixelExpr<E>& e, const pointTable& table)
+{
+    return tableExpr<E>(e.self(), table);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes an expression of the gray value of red, green and blue expressions
+ *
+ * @param[in] r - red expression in [0, 255]
+ * @param[in] g - green expression in [0, 255]
+ * @param[in] b - blue expression in [0, 255]
+ *
+ * @returns returns the expression
+ *
+ *****************************************************************************/
+template <class R, class G, class B>
+grayExpr<R, G, B> grayPixel(const pixelExpr<R>& r, const pixelExpr<G>& g,
+    const pixelExpr<B>& b)
+{
+    return grayExpr<R, G, B>(r.self(), g.self(), b.self());
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Evaluates an expression at every pixel in one pass and stores it in a
+ * colorband, with the rows split over threads. A pixel is only read by the
+ * expression before it is stored, so the colorband may be read by the
+ * expression too.
+ *
+ * @param[out] colorband - colorband to store the values in
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ * @param[in] expr - expression giving values in [0, 255], wrap it in
+ * clampPixel if it may not
+ *
+ *****************************************************************************/
+template <class E>
+void evaluate(pixel** colorband, int rows, int cols, const pixelExpr<E>& expr)
+{
+    const E& root = expr.self();
+
+    parallelRows(rows, threadCount(rows), [&](int first, int last, int)
+    {
+        E local = root;
+        pixel* row;
+        int i, j, width = cols;
+
+        for (i = first; i < last; i++)
+        {
+            local.bind(i);
+            row = colorband[i];
+
+            // width is a local copy, so the stores cannot change the trip
+            // count and the loop can be vectorized
+            for (j = 0; j < width; j++)
+            {
+                row[j] = (pixel)local[j];
+            }
+        }
+    });
+}
+
+#endif
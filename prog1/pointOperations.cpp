@@ -0,0 +1,296 @@
+/** **************************************************************************
+ * @file
+ * 
+ * @brief The source code for point operations, image operations where each
+ * new color value depends only on the old one
+ ****************************************************************************/
+
+#include "netPBM.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a table that leaves every color value unchanged
+ *
+ * @returns returns the table
+ *
+ *****************************************************************************/
+pointTable identityTable()
+{
+    pointTable table;
+    int i;
+
+    for (i = 0; i < 256; i++)
+    {
+        table.value[i] = i;
+    }
+
+    return table;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a table that negates color values
+ *
+ * @returns returns the table
+ *
+ *****************************************************************************/
+pointTable negateTable()
+{
+    pointTable table;
+    int i;
+
+    for (i = 0; i < 256; i++)
+    {
+        table.value[i] = 255 - i;
+    }
+
+    return table;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a table that brightens color values
+ *
+ * @param[in] value - value to be added to color values
+ *
+ * @returns returns the table
+ *
+ *****************************************************************************/
+pointTable brightenTable(int value)
+{
+    pointTable table;
+    int i;
+
+    for (i = 0; i < 256; i++)
+    {
+        table.value[i] = cropNum(i + value);
+    }
+
+    return table;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a table that stretches color values in [min, max] to [0, 255].
+ * A single value has nothing to stretch, so the values are left alone.
+ *
+ * @param[in] min - smallest color value in the image
+ * @param[in] max - largest color value in the image
+ *
+ * @returns returns the table
+ *
+ *****************************************************************************/
+pointTable stretchTable(int min, int max)
+{
+    pointTable table;
+    double scale;
+    int i;
+
+    if (max <= min) return identityTable();
+
+    scale = 255.0 / (max - min);
+    for (i = 0; i < 256; i++)
+    {
+        table.value[i] = cropNum((int)round(scale * (i - min)));
+    }
+
+    return table;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a table that equalizes a colorband, mapping each value by the
+ * share of pixels at or below it so the values are spread evenly over
+ * [0, 255]
+ *
+ * @param[in] hist - histogram of the image
+ * @param[in] channel - colorband of the histogram
+ *
+ * @returns returns the table
+ *
+ *****************************************************************************/
+pointTable equalizeTable(const histogram& hist, int channel)
+{
+    pointTable table;
+    size_t cdf[256], lowest;
+    int i;
+
+    cumulativeCounts(hist, channel, cdf);
+    lowest = cdf[histogramPercentile(hist, channel, 0)];
+
+    // a single value has nothing to spread
+    if (hist.pixels <= lowest) return identityTable();
+
+    for (i = 0; i < 256; i++)
+    {
+        table.value[i] = cdf[i] < lowest ? 0 : (pixel)round(255.0
+            * (cdf[i] - lowest) / (hist.pixels - lowest));
+    }
+
+    return table;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Combines two tables into one that applies the first, then the second
+ *
+ * @param[in] first - table applied first
+ * @param[in] second - table applied to the result of the first
+ *
+ * @returns returns the combined table
+ *
+ *****************************************************************************/
+pointTable composeTables(const pointTable& first, const pointTable& second)
+{
+    pointTable table;
+    int i;
+
+    for (i = 0; i < 256; i++)
+    {
+        table.value[i] = second.value[first.value[i]];
+    }
+
+    return table;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Replaces every color value in a colorband with its value in a table. The
+ * loop is unrolled so several lookups are in flight at once.
+ *
+ * @param[in,out] colorband - the colorband to change
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ * @param[in] table - table of new color values
+ *
+ *****************************************************************************/
+void applyTable(pixel** colorband, int rows, int cols, const pointTable& table)
+{
+    const pixel* value = table.value;
+    pixel* row;
+    int i, j;
+
+    for (i = 0; i < rows; i++)
+    {
+        row = colorband[i];
+        for (j = 0; j + 8 <= cols; j += 8)
+        {
+            row[j] = value[row[j]];
+            row[j + 1] = value[row[j + 1]];
+            row[j + 2] = value[row[j + 2]];
+            row[j + 3] = value[row[j + 3]];
+            row[j + 4] = value[row[j + 4]];
+            row[j + 5] = value[row[j + 5]];
+            row[j + 6] = value[row[j + 6]];
+            row[j + 7] = value[row[j + 7]];
+        }
+        for (; j < cols; j++)
+        {
+            row[j] = value[row[j]];
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Replaces every color value in every colorband of an image with its value
+ * in a table
+ *
+ * @param[in,out] img - image structure
+ * @param[in] table - table of new color values
+ *
+ *****************************************************************************/
+void applyTable(image& img, const pointTable& table)
+{
+    if (img.redgray != nullptr)
+    {
+        applyTable(img.redgray, img.rows, img.cols, table);
+    }
+
+    if (img.green != nullptr)
+    {
+        applyTable(img.green, img.rows, img.cols, table);
+    }
+
+    if (img.blue != nullptr)
+    {
+        applyTable(img.blue, img.rows, img.cols, table);
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Creates a chain of point operations that changes nothing
+ *
+ * @returns returns the chain
+ *
+ *****************************************************************************/
+pointChain emptyChain()
+{
+    pointChain chain;
+
+    chain.before = identityTable();
+    chain.gray = false;
+    chain.after = identityTable();
+    chain.steps = 0;
+
+    return chain;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Adds a point operation on color values to the end of a chain. Before the
+ * chain converts to grayscale it applies to each colorband, after that to
+ * the gray value.
+ *
+ * @param[in,out] chain - chain of point operations
+ * @param[in] table - table of the operation
+ *
+ *****************************************************************************/
+void chainTable(pointChain& chain, const pointTable& table)
+{
+    if (chain.gray)
+    {
+        chain.after = composeTables(chain.after, table);
+    }
+    else {
+        chain.before = composeTables(chain.before, table);
+    }
+    chain.steps++;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Adds converting to grayscale to the end of a chain. A gray value is
+ * already gray, so converting it again changes nothing.
+ *
+ * @param[in,out] chain - chain of point operations
+ *
+ *****************************************************************************/
+void chainGray(pointChain& chain)
+{
+    chain.gray = true;
+    chain.steps++;
+}
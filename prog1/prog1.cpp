@@ -44,8 +44,11 @@
   *
   * @par Usage:
     @verbatim
-    c:\> prog1.exe [option] -o[ab] basename image.ppm
-             [option] - option to manipulate input image, -[n, b #, p, s, g, c, k #]
+    c:\> prog1.exe [option] [region] -o[ab] basename image.ppm
+             [option] - option to manipulate input image, -[n, b #, p, s [#], g, c, l #, q, t sp, f sp, y, k #, e], --gauss #, --median #,
+                      --erode WxH, --dilate WxH, --open WxH, --close WxH, --threshold #,
+                      --bilateral # #
+             [region] - optional rectangle to restrict the option to, -[r, x] row col rows cols
              -o[ab] - output in ASCII [a] or Binary [b]
              basename - name/location of output file with no extension
              image.ppm - name/location of input file with .ppm extension
@@ -56,12 +59,81 @@
     -n    - Negates the image (ex: "prog1.exe -n -oa output input.ppm")
     -b #  - Brightens the image by the number supplied (ex: "prog1.exe -b 40 -ob output input.ppm", brightens the image by 40)
     -p    - Sharpens the image (ex: "prog1.exe -p -ob output input.ppm")
-    -s    - Smooths the image (ex: "prog1.exe -s -oa output input.ppm")
+    -s [#] - Smooths the image by averaging the box of radius # around each pixel, 1 (3x3) if not given
+            (ex: "prog1.exe -s -oa output input.ppm", "prog1.exe -s 5 -oa output input.ppm", valid radius: [1, 500])
+    --gauss # - Blurs the image with a Gaussian of standard deviation #, in the same time whatever #
+            (ex: "prog1.exe --gauss 2.5 -ob output input.ppm", valid standard deviation: [0.5, 50])
+    --median # - Replaces each pixel with the median of the box of radius # around it in each colorband,
+            removing salt and pepper noise (ex: "prog1.exe --median 2 -ob output input.ppm", valid radius: [1, 100])
+    --erode WxH  - Replaces each pixel with the smallest value in the W column by H row rectangle around it
+    --dilate WxH - Replaces each pixel with the largest value in the W column by H row rectangle around it
+    --open WxH   - Erodes and then dilates, removing bright details smaller than the rectangle
+    --close WxH  - Dilates and then erodes, filling dark details smaller than the rectangle
+            (ex: "prog1.exe --open 15x3 -ob output input.ppm", valid sizes: [1, 1001], the same time for any size,
+            pixels past the edge of the image are left out of the rectangle)
+    --threshold # - Sets each color value to 255 or 0 by comparing it with the mean and standard deviation of the
+            box of radius # around it (Sauvola), in the same time whatever #, boxes stop at the edge of the image
+            (ex: "prog1.exe --threshold 7 -ob output input.ppm", valid radius: [1, 1000])
+    --bilateral # # - Smooths the image but not across its edges, averaging the pixels about the first # of pixels away
+            whose gray value is within about the second #, on a coarse grid of cells a standard deviation on a side,
+            so it runs faster as either # grows and slowest at small #s, worked through in strips of at most 64 MB
+            (ex: "prog1.exe --bilateral 16 20 -ob output input.ppm", valid standard deviations: [2, 100] and [4, 255])
     -g    - Converts the image to grayscale (ex: "prog1.exe -g -oa output input.ppm")
     -c    - Converts to grayscale, then contrast the image (ex: "prog1.exe -c -ob output input.ppm")
+    -l #  - Converts to grayscale, then contrasts the image ignoring the darkest and brightest # percent
+            of pixels (ex: "prog1.exe -l 1 -ob output input.ppm")
+    -q    - Converts to grayscale, then equalizes the histogram (ex: "prog1.exe -q -ob output input.ppm")
+    -t sp - Converts the image from RGB to color space sp: ycbcr or hsv, the colorbands are output as
+            red, green and blue (ex: "prog1.exe -t ycbcr -ob output input.ppm")
+    -f sp - Converts the image from color space sp back to RGB, can be used with -t but with no other option
+            (ex: "prog1.exe -f hsv -ob output input.ppm")
+    -y    - With -p, -s, --gauss, --median or --bilateral, only sharpens or smooths the luma of the image (ex: "prog1.exe -p -y -ob output input.ppm")
     -k #  - Scale the image (ex: "prog1.exe -k 200 -oa output input.ppm", scales the image by 200%, valid scale input: [50, 200])
     -e    - Detects edges from change in intensity
     @endverbatim
+  *
+  * @par Chaining:
+    @verbatim
+    -n, -b # and -g can be given together, but with no other option, and are applied in the order
+    given, in one pass over the image (ex: "prog1.exe -n -b 40 -g -ob output input.ppm", negates,
+    brightens by 40, then converts to grayscale)
+    @endverbatim
+  *
+  * @par Regions:
+    @verbatim
+    -r row col rows cols - Only alters the given rectangle, the rest of the image is output unchanged
+                           (ex: "prog1.exe -n -r 10 20 100 200 -oa output input.ppm")
+    -x row col rows cols - Only alters and outputs the given rectangle
+                           (ex: "prog1.exe -s -x 10 20 100 200 -ob output input.ppm")
+    @endverbatim
+  *
+  * @par Memory:
+    @verbatim
+    --mem-limit #  - Limits the image arrays to # megabytes. Negate, brighten, sharpen, smooth,
+                     grayscale and chains of them stream the image through in strips when the whole
+                     image would not fit, any other option is refused up front. The image arrays,
+                     int arrays, sum tables and bilateral grid strips are counted as they are allocated;
+                     per-thread scratch that grows with the image (median histograms, Gaussian and
+                     morphology buffers) is only counted in the up front check, and buffers of a few
+                     rows (tile copies, pipeline rows) are not counted.
+                     (ex: "prog1.exe -s --mem-limit 64 -ob output input.ppm")
+    --tile RxC     - Sharpens and smooths R rows by C columns at a time, sized so a tile of all
+                     three colorbands stays in the L2 cache (default 64x512)
+                     (ex: "prog1.exe -s 4 --tile 32x256 -ob output input.ppm")
+    --border mode  - How sharpen, smooth, median and edge detection treat the edge of the image: black
+                     (the edge pixels are set to 0, the default), zero (reads 0 past the edge),
+                     clamp (repeats the edge), mirror (reflects about the edge) or wrap (reads the
+                     other side of the image, never streamed)
+                     (ex: "prog1.exe -s 3 --border mirror -ob output input.ppm")
+    --mem-stats    - Outputs the current and peak memory used by the image arrays when done
+    --pages mode   - Pages backing image arrays of 2 MB or more: normal, thp (transparent huge
+                     pages, the default) or hugetlb (reserved huge pages, falls back to thp).
+                     Huge pages are only used on Linux.
+                     (ex: "prog1.exe -e --pages normal -ob output input.ppm")
+    --stride-pad # - Bytes added to rows whose length is a multiple of 512 bytes, so rows read
+                     together by stencils do not evict each other from the cache (default 64, 0 for none)
+                     (ex: "prog1.exe -s --stride-pad 0 -ob output input.ppm")
+    @endverbatim
   * @section todo_bugs_modification_section Todo, Bugs, and Modifications
   * 
   * @bug Edge Detection hysteresis appears to timeout
@@ -84,78 +156,259 @@
  *****************************************************************************/
 int main(int argc, char** argv)
 {
-    int briNum = 0, scaleNum = 100, rows, cols,
-        maxPixelVal = 0;
+    int rows, cols,
+        maxPixelVal = 0, i, regRow = 0, regCol = 0, regRows = 0, regCols = 0;
     string inputImage, outputName,
         outputMagicNumber, magicNumber;
     vector<string> comments;
+    size_t footprint;
+    bool grayOutput, fused, stream = false, memStats = false, spaces = false;
 
-    imageOption option = BRIGHTEN;
+    optionSettings settings;
+    regionMode region = WHOLE;
     outputMode mode;
 
-    image img;
+    image img, work;
+    pixel** band = nullptr;
 
     ifstream fin;
     ofstream fout;
 
+    settings.option = BRIGHTEN;
+    settings.briNum = 0;
+    settings.scaleNum = 100;
+    settings.radius = 1;
+    settings.sigma = 1;
+    settings.rangeSigma = 1;
+    settings.elemRows = 3;
+    settings.elemCols = 3;
+    settings.clip = 0;
+    settings.from = RGB_SPACE;
+    settings.to = RGB_SPACE;
+    settings.luma = false;
+    settings.chain = emptyChain();
+
     // invalid argument amount
-    if (argc < 4 || argc > 6)
+    if (argc < 4)
     {
-        cout << "Usage: prog1.exe [option] -o[ab] basename image.ppm" << endl;
-        exit(0);
+        printUsage();
     }
 
-    // options selected
-    if (argc > 4)
+    // options selected, the last three arguments are output mode and files
+    for (i = 1; i < argc - 3; i++)
     {
-        if (argc == 5)
+        if (strcmp(argv[i], "-n") == 0)
+        {
+            if (!isPointOption(settings.option)) printUsage();
+            settings.option = NEGATE;
+            chainTable(settings.chain, negateTable());
+        }
+        else if (strcmp(argv[i], "-p") == 0)
         {
-            if (strcmp(argv[1], "-n") == 0)
+            settings.option = SHARPEN;
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+        {
+            settings.option = SMOOTH;
+            if (i + 1 < argc - 3 && isdigit(argv[i + 1][0]))
             {
-                option = NEGATE;
+                settings.radius = min(max(atoi(argv[++i]), 1), MAX_RADIUS);
             }
-            else if (strcmp(argv[1], "-p") == 0)
+        }
+        else if (strcmp(argv[i], "--gauss") == 0 && i + 1 < argc - 3)
+        {
+            settings.option = GAUSS;
+            settings.sigma = min(max(atof(argv[++i]), MIN_SIGMA), MAX_SIGMA);
+        }
+        else if (strcmp(argv[i], "--median") == 0 && i + 1 < argc - 3)
+        {
+            settings.option = MEDIAN;
+            settings.radius = min(max(atoi(argv[++i]), 1), MAX_MEDIAN);
+        }
+        else if ((strcmp(argv[i], "--erode") == 0 || strcmp(argv[i], "--dilate") == 0
+            || strcmp(argv[i], "--open") == 0 || strcmp(argv[i], "--close") == 0)
+            && i + 1 < argc - 3)
+        {
+            settings.option = argv[i][2] == 'e' ? ERODE : argv[i][2] == 'd' ? DILATE
+                : argv[i][2] == 'o' ? OPEN : CLOSE;
+
+            // columns and rows of the rectangle, given as WxH
+            i++;
+            if (strchr(argv[i], 'x') == nullptr)
             {
-                option = SHARPEN;
+                printUsage();
             }
-            else if (strcmp(argv[1], "-s") == 0)
+            settings.elemCols = min(max(atoi(argv[i]), 1), MAX_ELEMENT);
+            settings.elemRows = min(max(atoi(strchr(argv[i], 'x') + 1), 1), MAX_ELEMENT);
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc - 3)
+        {
+            settings.option = THRESHOLD;
+            settings.radius = min(max(atoi(argv[++i]), 1), MAX_THRESHOLD);
+        }
+        else if (strcmp(argv[i], "--bilateral") == 0 && i + 2 < argc - 3)
+        {
+            settings.option = BILATERAL;
+            settings.sigma = min(max(atof(argv[++i]), MIN_SPACE_SIGMA), MAX_SPACE_SIGMA);
+            settings.rangeSigma = min(max(atof(argv[++i]), MIN_RANGE_SIGMA), MAX_RANGE_SIGMA);
+        }
+        else if (strcmp(argv[i], "-g") == 0)
+        {
+            if (!isPointOption(settings.option)) printUsage();
+            settings.option = GRAYSCALE;
+            chainGray(settings.chain);
+        }
+        else if (strcmp(argv[i], "-c") == 0)
+        {
+            settings.option = CONTRAST;
+        }
+        else if (strcmp(argv[i], "-e") == 0)
+        {
+            settings.option = EDGE;
+        }
+        else if (strcmp(argv[i], "-q") == 0)
+        {
+            settings.option = EQUALIZE;
+        }
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc - 3)
+        {
+            settings.option = CONTRAST;
+            settings.clip = min(max(atof(argv[++i]), 0.0), 49.0);
+        }
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc - 3)
+        {
+            if (!isPointOption(settings.option)) printUsage();
+            settings.option = BRIGHTEN;
+            settings.briNum = atoi(argv[++i]);
+            chainTable(settings.chain, brightenTable(settings.briNum));
+        }
+        else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-f") == 0)
+            && i + 1 < argc - 3)
+        {
+            // a conversion is done on its own
+            if (settings.option != CONVERT && (!isPointOption(settings.option)
+                || settings.chain.steps > 0))
+            {
+                printUsage();
+            }
+            settings.option = CONVERT;
+            spaces = true;
+            if (argv[i][1] == 't')
+            {
+                settings.to = parseColorSpace(argv[++i]);
+            }
+            else {
+                settings.from = parseColorSpace(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "-y") == 0)
+        {
+            settings.luma = true;
+        }
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc - 3)
+        {
+            settings.option = SCALE;
+            settings.scaleNum = atoi(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "-x") == 0)
+            && i + 4 < argc - 3)
+        {
+            region = (argv[i][1] == 'r') ? INPLACE : CROP;
+            regRow = atoi(argv[++i]);
+            regCol = atoi(argv[++i]);
+            regRows = atoi(argv[++i]);
+            regCols = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--mem-limit") == 0 && i + 1 < argc - 3)
+        {
+            setMemoryLimit((size_t)max(atoi(argv[++i]), 1) * MEGABYTE);
+        }
+        else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc - 3)
+        {
+            // rows and columns of a tile, given as RxC
+            i++;
+            if (strchr(argv[i], 'x') == nullptr)
+            {
+                printUsage();
+            }
+            setTileSize(atoi(argv[i]), atoi(strchr(argv[i], 'x') + 1));
+        }
+        else if (strcmp(argv[i], "--border") == 0 && i + 1 < argc - 3)
+        {
+            i++;
+            if (strcmp(argv[i], "black") == 0)
+            {
+                setBorderMode(BLACK_BORDER);
+            }
+            else if (strcmp(argv[i], "zero") == 0)
             {
-                option = SMOOTH;
+                setBorderMode(ZERO_BORDER);
             }
-            else if (strcmp(argv[1], "-g") == 0)
+            else if (strcmp(argv[i], "clamp") == 0)
             {
-                option = GRAYSCALE;
+                setBorderMode(CLAMP_BORDER);
             }
-            else if (strcmp(argv[1], "-c") == 0)
+            else if (strcmp(argv[i], "mirror") == 0)
             {
-                option = CONTRAST;
+                setBorderMode(MIRROR_BORDER);
             }
-            else if (strcmp(argv[1], "-e") == 0)
+            else if (strcmp(argv[i], "wrap") == 0)
             {
-                option = EDGE;
+                setBorderMode(WRAP_BORDER);
             }
             else {
-                cout << "Usage: prog1.exe [option] -o[ab] basename image.ppm" << endl;
-                exit(0);
+                printUsage();
             }
         }
-        else if (argc == 6)
+        else if (strcmp(argv[i], "--mem-stats") == 0)
+        {
+            memStats = true;
+        }
+        else if (strcmp(argv[i], "--stride-pad") == 0 && i + 1 < argc - 3)
+        {
+            setStridePadding(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc - 3)
         {
-            if (strcmp(argv[1], "-b") == 0)
+            i++;
+            if (strcmp(argv[i], "normal") == 0)
+            {
+                setPageMode(NORMAL_PAGES);
+            }
+            else if (strcmp(argv[i], "thp") == 0)
             {
-                option = BRIGHTEN;
-                briNum = atoi(argv[2]);
+                setPageMode(TRANSPARENT_HUGE_PAGES);
             }
-            else if (strcmp(argv[1], "-k") == 0)
+            else if (strcmp(argv[i], "hugetlb") == 0)
             {
-                option = SCALE;
-                scaleNum = atoi(argv[2]);
+                setPageMode(HUGETLB_PAGES);
             }
             else {
-                cout << "Usage: prog1.exe [option] -o[ab] basename image.ppm" << endl;
-                exit(0);
+                printUsage();
             }
         }
+        else {
+            printUsage();
+        }
+    }
+
+    // an option after -t or -f would drop the conversion
+    if (spaces && settings.option != CONVERT)
+    {
+        printUsage();
+    }
+
+    // point operations only chain with each other, an option after them
+    // would drop the chain
+    if (settings.chain.steps > 0 && !isPointOption(settings.option))
+    {
+        printUsage();
+    }
+
+    // several point operations are done in one pass
+    if (settings.chain.steps > 1)
+    {
+        settings.option = CHAIN;
     }
 
     if (strcmp(argv[argc - 3], "-oa") == 0)
@@ -178,94 +431,462 @@ int main(int argc, char** argv)
     // read in header
     readHeader(fin, magicNumber, comments, rows, cols, maxPixelVal);
 
-    // dynamically allocate 3 2d arrays
-    img.cols = cols;
-    img.rows = rows;
-    img.redgray = alloc2D(img.rows, img.cols);
-    img.blue = alloc2D(img.rows, img.cols);
-    img.green = alloc2D(img.rows, img.cols);
+    // check region fits in the image
+    if (region != WHOLE && (regRow < 0 || regCol < 0 || regRows < 1 ||
+        regCols < 1 || regRow + regRows > rows || regCol + regCols > cols))
+    {
+        cout << "Invalid region: must lie within the " << rows << "x" << cols
+            << " image" << endl;
+        exit(0);
+    }
 
-    // read in image data
-    if (magicNumber.compare(P3) == 0)
+    // scaling changes the size, so the region cannot be put back
+    if (region == INPLACE && settings.option == SCALE)
     {
-        readASCII(fin, img);
+        cout << "Scaling a region requires -x" << endl;
+        exit(0);
+    }
+
+    // point operations on binary input are done while it is read in, a
+    // grayscale image is then read straight into one colorband
+    fused = magicNumber.compare(P6) == 0 && region == WHOLE
+        && (settings.option == NEGATE || settings.option == BRIGHTEN
+        || settings.option == GRAYSCALE || settings.option == CHAIN);
+
+    // stream the image in strips if the whole image will not fit
+    footprint = predictFootprint(settings, rows, cols);
+    if (fused && settings.chain.gray)
+    {
+        footprint = planeBytes(rows, cols);
+    }
+    if (getMemoryLimit() != 0 && footprint > getMemoryLimit())
+    {
+        stream = region == WHOLE && (settings.option == NEGATE || settings.option == BRIGHTEN
+            || settings.option == SHARPEN || settings.option == SMOOTH || settings.option == GRAYSCALE
+            || settings.option == CHAIN);
+
+        // a wrapped border reads the other end of the image, not in the strip
+        if (getBorderMode() == WRAP_BORDER && (settings.option == SHARPEN
+            || settings.option == SMOOTH))
+        {
+            stream = false;
+        }
+        if (!stream)
+        {
+            cout << "Option needs about " << footprint / MEGABYTE + 1
+                << " MB, over the memory limit of " << getMemoryLimit() / MEGABYTE
+                << " MB" << endl;
+            exit(0);
+        }
+    }
+
+    // determine output file magic number and filename, a grayscale region
+    // inside a color image is output in color
+    grayOutput = (settings.option == GRAYSCALE || settings.option == CONTRAST
+        || settings.option == EQUALIZE || settings.option == EDGE
+        || (settings.option == CHAIN && settings.chain.gray)) && region != INPLACE;
+    if (grayOutput)
+    {
+        if (mode == ASCII)
+        {
+            outputMagicNumber = P2;
+        }
+        else
+        {
+            outputMagicNumber = P5;
+        }
+        outputName.append(".pgm");
+    }
+    else {
+        if (mode == ASCII)
+        {
+            outputMagicNumber = P3;
+        }
+        else
+        {
+            outputMagicNumber = P6;
+        }
+        outputName.append(".ppm");
+    }
+
+    if (stream)
+    {
+        openFileOut(fout, outputName);
+        writeHeader(fout, outputMagicNumber, comments, rows, cols, maxPixelVal);
+        streamOption(fin, fout, magicNumber.compare(P3) == 0, mode, rows, cols,
+            settings);
+    }
+    else {
+        // dynamically allocate 3 2d arrays
+        img.cols = cols;
+        img.rows = rows;
+        img.redgray = alloc2D(img.rows, img.cols);
+        img.blue = nullptr;
+        img.green = nullptr;
+        if (!fused || !settings.chain.gray)
+        {
+            img.blue = alloc2D(img.rows, img.cols);
+            img.green = alloc2D(img.rows, img.cols);
+        }
+
+        // read in image data
+        if (fused)
+        {
+            readBINChain(fin, img, settings.chain);
+        }
+        else if (magicNumber.compare(P3) == 0)
+        {
+            readASCII(fin, img);
+        }
+        else
+        {
+            readBIN(fin, img);
+        }
+
+        // operations work on a view of the region without copying it
+        work = img;
+        if (region != WHOLE)
+        {
+            work = imageView(img, regRow, regCol, regRows, regCols);
+        }
+
+        if (!fused)
+        {
+            applyOption(work, settings);
+        }
+
+        // a grayscale region inside a color image is copied to all colorbands
+        if (region == INPLACE && work.green == nullptr)
+        {
+            band = view2D(img.green, regRow, regCol, regRows);
+            copy2D(work.redgray, band, regRows, regCols);
+            free2D(band, regRows);
+            band = view2D(img.blue, regRow, regCol, regRows);
+            copy2D(work.redgray, band, regRows, regCols);
+            free2D(band, regRows);
+        }
+
+        // the whole image is output unless only the region was asked for
+        if (region == WHOLE)
+        {
+            img = work;
+        }
+        else if (region == CROP)
+        {
+            swap(img, work);
+        }
+
+        // open output file
+        openFileOut(fout, outputName);
+
+        // write image data
+        writeHeader(fout, outputMagicNumber, comments, img.rows, img.cols, maxPixelVal);
+        if (mode == ASCII)
+        {
+            writeASCII(fout, img);
+        }
+        else {
+            writeBIN(fout, img);
+        }
+
+        // clean up/free memory
+        free2D(img.redgray, img.rows);
+        free2D(img.blue, img.rows);
+        free2D(img.green, img.rows);
+        if (region != WHOLE)
+        {
+            free2D(work.redgray, work.rows);
+            free2D(work.blue, work.rows);
+            free2D(work.green, work.rows);
+        }
     }
-    else 
+
+    if (memStats)
     {
-        readBIN(fin, img);
+        memoryReport(cout);
     }
 
-    // apply options
-    switch (option)
+    closeFileIn(fin);
+    closeFileOut(fout);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Applies a command line option to an image
+ *
+ * @param[in,out] img - image structure
+ * @param[in] settings - option to apply and its values
+ *
+ *****************************************************************************/
+void applyOption(image& img, const optionSettings& settings)
+{
+    image luma;
+
+    switch (settings.option)
     {
     case(NEGATE):
         imageNegate(img);
         break;
     case(BRIGHTEN):
-        imageBrighten(img, briNum);
+        imageBrighten(img, settings.briNum);
         break;
     case(SHARPEN):
-        imageSharpen(img);
-        break;
     case(SMOOTH):
-        imageSmooth(img);
+    case(GAUSS):
+    case(MEDIAN):
+    case(BILATERAL):
+        // luma is the first colorband, the differences are left alone
+        luma = img;
+        if (settings.luma && img.green != nullptr)
+        {
+            rgbToYCbCr(img);
+            luma.green = nullptr;
+            luma.blue = nullptr;
+        }
+        if (settings.option == SHARPEN)
+        {
+            imageSharpen(luma);
+        }
+        else if (settings.option == GAUSS)
+        {
+            imageGaussian(luma, settings.sigma);
+        }
+        else if (settings.option == MEDIAN)
+        {
+            imageMedian(luma, settings.radius);
+        }
+        else if (settings.option == BILATERAL)
+        {
+            imageBilateral(luma, settings.sigma, settings.rangeSigma);
+        }
+        else {
+            imageSmooth(luma, settings.radius);
+        }
+        if (settings.luma && img.green != nullptr)
+        {
+            yCbCrToRGB(img);
+        }
         break;
     case(GRAYSCALE):
         imageGrayscale(img);
         break;
     case(CONTRAST):
-        imageContrast(img);
+        imageContrast(img, settings.clip);
+        break;
+    case(EQUALIZE):
+        imageEqualize(img);
         break;
     case(SCALE):
-        imageScale(img, scaleNum);
+        imageScale(img, settings.scaleNum);
         break;
     case(EDGE):
         imageEdgeDetection(img);
         break;
+    case(CONVERT):
+        convertColorSpace(img, settings.from, settings.to);
+        break;
+    case(CHAIN):
+        imagePointChain(img, settings.chain);
+        break;
+    case(ERODE):
+        imageErode(img, settings.elemRows, settings.elemCols);
+        break;
+    case(DILATE):
+        imageDilate(img, settings.elemRows, settings.elemCols);
+        break;
+    case(OPEN):
+        imageOpen(img, settings.elemRows, settings.elemCols);
+        break;
+    case(CLOSE):
+        imageClose(img, settings.elemRows, settings.elemCols);
+        break;
+    case(THRESHOLD):
+        imageThreshold(img, settings.radius);
+        break;
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Applies an option to an image too big for the memory limit by reading,
+ * altering and writing it a strip of rows at a time. Sharpen and smooth
+ * keep the last unaltered rows of a strip, twice the rows they reach up or
+ * down, at the top of the next one, so every output row was altered with
+ * its real neighbors. Only the top and bottom rows of the image are
+ * treated as a border. Point operations on
+ * binary input are applied as each strip is read in.
+ *
+ * @param[in,out] fin - input file, positioned at the image data
+ * @param[in,out] fout - output file, positioned after the header
+ * @param[in] asciiIn - true if the input image data is ASCII
+ * @param[in] mode - output mode
+ * @param[in] rows - number of rows in the image
+ * @param[in] cols - number of columns in the image
+ * @param[in] settings - option to apply and its values, an option that
+ * works pixel by pixel or on a 3x3 neighborhood
+ *
+ *****************************************************************************/
+void streamOption(ifstream& fin, ofstream& fout, bool asciiIn, outputMode mode,
+    int rows, int cols, const optionSettings& settings)
+{
+    int halo = settings.option == SHARPEN ? 1
+        : settings.option == SMOOTH ? settings.radius : 0;
+    bool fused = !asciiIn && (settings.option == NEGATE || settings.option == BRIGHTEN
+        || settings.option == GRAYSCALE || settings.option == CHAIN);
+    bool gray = settings.option == GRAYSCALE
+        || (settings.option == CHAIN && settings.chain.gray);
+    int capacity, next = 0, kept = 0, count, filled, first, last;
+    size_t fixed, perRow, limit = getMemoryLimit();
+    image strip, saved, part;
+
+    // strip rows that fit once the halo rows are set aside
+    fixed = 3 * planeBytes(0, cols) + 3 * planeBytes(2 * halo, cols);
+    perRow = 3 * (planeBytes(1, cols) - planeBytes(0, cols));
+    capacity = limit > fixed ? (int)min((limit - fixed) / perRow, (size_t)rows) : 0;
+    if (capacity < 2 * halo + 1)
+    {
+        cout << "Memory limit of " << limit / MEGABYTE
+            << " MB is too small for one strip of the image" << endl;
+        exit(0);
     }
 
-    // determine output file magic number and filename
-    if (option == GRAYSCALE || option == CONTRAST || option == EDGE)
+    strip.rows = capacity;
+    strip.cols = cols;
+    strip.redgray = alloc2D(capacity, cols);
+    strip.green = alloc2D(capacity, cols);
+    strip.blue = alloc2D(capacity, cols);
+    saved.rows = 2 * halo;
+    saved.cols = cols;
+    saved.redgray = halo ? alloc2D(2 * halo, cols) : nullptr;
+    saved.green = halo ? alloc2D(2 * halo, cols) : nullptr;
+    saved.blue = halo ? alloc2D(2 * halo, cols) : nullptr;
+
+    while (next < rows)
     {
-        if (mode == ASCII)
+        // read rows in after the ones kept from the last strip
+        count = min(capacity - kept, rows - next);
+        part = imageView(strip, kept, 0, count, cols);
+        if (fused)
         {
-            outputMagicNumber = P2;
+            // only the first colorband of the strip is used for grayscale
+            if (gray)
+            {
+                free2D(part.green, part.rows);
+                free2D(part.blue, part.rows);
+            }
+            readBINChain(fin, part, settings.chain);
         }
-        else
+        else if (asciiIn)
         {
-            outputMagicNumber = P5;
+            readASCII(fin, part);
+        }
+        else {
+            readBIN(fin, part);
+        }
+        freeImage(part);
+        first = next == 0 ? 0 : halo;
+        next += count;
+        filled = kept + count;
+        last = next == rows ? filled : filled - halo;
+
+        // keep the unaltered rows the next strip needs as neighbors
+        if (halo && next < rows)
+        {
+            part = imageView(strip, filled - 2 * halo, 0, 2 * halo, cols);
+            copy2D(part.redgray, saved.redgray, 2 * halo, cols);
+            copy2D(part.green, saved.green, 2 * halo, cols);
+            copy2D(part.blue, saved.blue, 2 * halo, cols);
+            freeImage(part);
+        }
+
+        if (!fused)
+        {
+            part = imageView(strip, 0, 0, filled, cols);
+            applyOption(part, settings);
+            freeImage(part);
+        }
+
+        // write the rows that had all their neighbors
+        part = imageView(strip, first, 0, last - first, cols);
+        if (gray)
+        {
+            free2D(part.green, part.rows);
+            free2D(part.blue, part.rows);
         }
-        outputName.append(".pgm");
-    }
-    else {
         if (mode == ASCII)
         {
-            outputMagicNumber = P3;
+            writeASCII(fout, part);
         }
-        else
+        else {
+            writeBIN(fout, part);
+        }
+        freeImage(part);
+
+        // move the kept rows to the top of the strip
+        if (halo && next < rows)
         {
-            outputMagicNumber = P6;
+            part = imageView(strip, 0, 0, 2 * halo, cols);
+            copy2D(saved.redgray, part.redgray, 2 * halo, cols);
+            copy2D(saved.green, part.green, 2 * halo, cols);
+            copy2D(saved.blue, part.blue, 2 * halo, cols);
+            freeImage(part);
+            kept = 2 * halo;
         }
-        outputName.append(".ppm");
     }
 
-    // open output file
-    openFileOut(fout, outputName);
+    freeImage(strip);
+    freeImage(saved);
+}
 
-    // write image data
-    writeHeader(fout, outputMagicNumber, comments, img.rows, img.cols, maxPixelVal);
-    if (mode == ASCII)
-    {
-        writeASCII(fout, img);
-    }
-    else {
-        writeBIN(fout, img);
-    }
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Gets the color space named on the command line
+ *
+ * @param[in] name - name of the color space: rgb, ycbcr or hsv
+ *
+ * @returns returns the color space, or prints the usage if it is unknown
+ *
+ *****************************************************************************/
+colorSpace parseColorSpace(const char* name)
+{
+    if (strcmp(name, "ycbcr") == 0) return YCBCR_SPACE;
+    if (strcmp(name, "hsv") == 0) return HSV_SPACE;
+    if (strcmp(name, "rgb") != 0) printUsage();
+    return RGB_SPACE;
+}
 
-    // clean up/free memory
-    free2D(img.redgray, img.rows);
-    free2D(img.blue, img.rows);
-    free2D(img.green, img.rows);
-    closeFileIn(fin);
-    closeFileOut(fout);
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Tells whether an option is a point operation, which can be chained with
+ * other point operations. No option given is a brighten by 0.
+ *
+ * @param[in] option - option from the command line
+ *
+ * @returns returns true for negate, brighten and grayscale
+ *
+ *****************************************************************************/
+bool isPointOption(imageOption option)
+{
+    return option == NEGATE || option == BRIGHTEN || option == GRAYSCALE;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Prints how to run the program, then exits
+ *
+ *****************************************************************************/
+void printUsage()
+{
+    cout << "Usage: prog1.exe [option] [region] -o[ab] basename image.ppm" << endl;
+    exit(0);
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+/** **************************************************************************
+ * @file
+ * 
+ * @brief Includes and macros for source files with SIMD kernels. Kernels
+ * for an instruction set are marked with its TARGET macro so they compile
+ * without enabling the instruction set for the whole program.
+ ****************************************************************************/
+
+#ifndef __SIMD__H__
+#define __SIMD__H__
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+#endif
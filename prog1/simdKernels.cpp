@@ -0,0 +1,811 @@
+/** **************************************************************************
+ * @file
+ * 
+ * @brief The source code for operations on whole colorbands using SIMD
+ * instructions, with the instruction set picked when the program runs
+ ****************************************************************************/
+
+#include "netPBM.h"
+#include "pixelExpr.h"
+#include "simd.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Asks the processor and operating system which SIMD instruction sets
+ * they support
+ *
+ * @returns returns the best supported instruction set
+ *
+ *****************************************************************************/
+static simdLevel probeSimd()
+{
+    simdLevel level = SIMD_SCALAR;
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 1);
+    if (info[3] & (1 << 26))
+    {
+        level = SIMD_SSE2;
+    }
+
+    // AVX2 also needs the operating system to save the ymm registers
+    if ((info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6)
+    {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5))
+        {
+            level = SIMD_AVX2;
+        }
+    }
+#elif defined(SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        level = SIMD_SSE2;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        level = SIMD_AVX2;
+    }
+#endif
+
+    return level;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the best SIMD instruction set the processor and operating system
+ * support. The answer is worked out once, by the first thread to ask, and
+ * remembered.
+ *
+ * @returns returns the best supported instruction set
+ *
+ *****************************************************************************/
+simdLevel detectSimd()
+{
+    static const simdLevel level = probeSimd();
+
+    return level;
+}
+
+#ifdef SIMD_X86
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Negates a row of color values 32 at a time with AVX2
+ *
+ * @param[in,out] row - the row to change
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns changed, a multiple of 32
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int negateRowAVX2(pixel* row, int cols)
+{
+    const __m256i ones = _mm256_set1_epi8((char)0xFF);
+    int j;
+
+    for (j = 0; j + 32 <= cols; j += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(row + j));
+        _mm256_storeu_si256((__m256i*)(row + j), _mm256_xor_si256(v, ones));
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Negates a row of color values 16 at a time with SSE2
+ *
+ * @param[in,out] row - the row to change
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns changed, a multiple of 16
+ *
+ *****************************************************************************/
+TARGET_SSE2 static int negateRowSSE2(pixel* row, int cols)
+{
+    const __m128i ones = _mm_set1_epi8((char)0xFF);
+    int j;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + j));
+        _mm_storeu_si128((__m128i*)(row + j), _mm_xor_si128(v, ones));
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Adds to or subtracts from a row of color values 32 at a time with AVX2,
+ * saturating at 0 and 255
+ *
+ * @param[in,out] row - the row to change
+ * @param[in] cols - columns in the row
+ * @param[in] amount - amount to add or subtract, [0, 255]
+ * @param[in] add - true to add, false to subtract
+ *
+ * @returns returns the number of columns changed, a multiple of 32
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int addRowAVX2(pixel* row, int cols, int amount, bool add)
+{
+    const __m256i delta = _mm256_set1_epi8((char)amount);
+    int j;
+
+    for (j = 0; j + 32 <= cols; j += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(row + j));
+        v = add ? _mm256_adds_epu8(v, delta) : _mm256_subs_epu8(v, delta);
+        _mm256_storeu_si256((__m256i*)(row + j), v);
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Adds to or subtracts from a row of color values 16 at a time with SSE2,
+ * saturating at 0 and 255
+ *
+ * @param[in,out] row - the row to change
+ * @param[in] cols - columns in the row
+ * @param[in] amount - amount to add or subtract, [0, 255]
+ * @param[in] add - true to add, false to subtract
+ *
+ * @returns returns the number of columns changed, a multiple of 16
+ *
+ *****************************************************************************/
+TARGET_SSE2 static int addRowSSE2(pixel* row, int cols, int amount, bool add)
+{
+    const __m128i delta = _mm_set1_epi8((char)amount);
+    int j;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + j));
+        v = add ? _mm_adds_epu8(v, delta) : _mm_subs_epu8(v, delta);
+        _mm_storeu_si128((__m128i*)(row + j), v);
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Computes grayTie for 16 colors with AVX2, four doubles at a time in the
+ * same order of operations
+ *
+ * @param[in] r - 16 red color values
+ * @param[in] g - 16 green color values
+ * @param[in] b - 16 blue color values
+ *
+ * @returns returns the 16 gray values
+ *
+ *****************************************************************************/
+TARGET_AVX2 static __m128i grayTieAVX2(__m128i r, __m128i g, __m128i b)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i words[3][2], gray[4];
+    __m256d color[3], value;
+    int c, k;
+
+    for (c = 0; c < 3; c++)
+    {
+        __m128i v = c == 0 ? r : c == 1 ? g : b;
+        words[c][0] = _mm_unpacklo_epi8(v, zero);
+        words[c][1] = _mm_unpackhi_epi8(v, zero);
+    }
+
+    for (k = 0; k < 4; k++)
+    {
+        for (c = 0; c < 3; c++)
+        {
+            color[c] = _mm256_cvtepi32_pd(k % 2
+                ? _mm_unpackhi_epi16(words[c][k / 2], zero)
+                : _mm_unpacklo_epi16(words[c][k / 2], zero));
+        }
+
+        value = _mm256_add_pd(_mm256_add_pd(
+            _mm256_mul_pd(_mm256_set1_pd(0.3), color[0]),
+            _mm256_mul_pd(_mm256_set1_pd(0.6), color[1])),
+            _mm256_mul_pd(_mm256_set1_pd(0.1), color[2]));
+        gray[k] = _mm256_cvttpd_epi32(_mm256_add_pd(value,
+            _mm256_set1_pd(0.5)));
+    }
+
+    return _mm_packus_epi16(_mm_packs_epi32(gray[0], gray[1]),
+        _mm_packs_epi32(gray[2], gray[3]));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Computes grayTie for 16 colors with SSE2, two doubles at a time in the
+ * same order of operations
+ *
+ * @param[in] r - 16 red color values
+ * @param[in] g - 16 green color values
+ * @param[in] b - 16 blue color values
+ *
+ * @returns returns the 16 gray values
+ *
+ *****************************************************************************/
+TARGET_SSE2 static __m128i grayTieSSE2(__m128i r, __m128i g, __m128i b)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i words[3][2], dwords[3], gray[4], rounded;
+    __m128d value;
+    int c, k, pair;
+
+    for (c = 0; c < 3; c++)
+    {
+        __m128i v = c == 0 ? r : c == 1 ? g : b;
+        words[c][0] = _mm_unpacklo_epi8(v, zero);
+        words[c][1] = _mm_unpackhi_epi8(v, zero);
+    }
+
+    for (k = 0; k < 4; k++)
+    {
+        for (c = 0; c < 3; c++)
+        {
+            dwords[c] = k % 2 ? _mm_unpackhi_epi16(words[c][k / 2], zero)
+                : _mm_unpacklo_epi16(words[c][k / 2], zero);
+        }
+
+        // two colors from the low half of dwords and two from the high half
+        for (pair = 0; pair < 2; pair++)
+        {
+            value = _mm_add_pd(_mm_add_pd(
+                _mm_mul_pd(_mm_set1_pd(0.3), _mm_cvtepi32_pd(dwords[0])),
+                _mm_mul_pd(_mm_set1_pd(0.6), _mm_cvtepi32_pd(dwords[1]))),
+                _mm_mul_pd(_mm_set1_pd(0.1), _mm_cvtepi32_pd(dwords[2])));
+            rounded = _mm_cvttpd_epi32(_mm_add_pd(value, _mm_set1_pd(0.5)));
+            if (pair == 0)
+            {
+                gray[k] = rounded;
+            }
+            else {
+                gray[k] = _mm_unpacklo_epi64(gray[k], rounded);
+            }
+            for (c = 0; c < 3; c++)
+            {
+                dwords[c] = _mm_srli_si128(dwords[c], 8);
+            }
+        }
+    }
+
+    return _mm_packus_epi16(_mm_packs_epi32(gray[0], gray[1]),
+        _mm_packs_epi32(gray[2], gray[3]));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row of color values to grayscale 32 at a time with AVX2. See
+ * grayscaleBands for how the values are computed.
+ *
+ * @param[in] red - row of red color values
+ * @param[in] green - row of green color values
+ * @param[in] blue - row of blue color values
+ * @param[out] gray - row of gray values, may be the same as red
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns converted, a multiple of 32
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int grayRowAVX2(const pixel* red, const pixel* green,
+    const pixel* blue, pixel* gray, int cols)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i five = _mm256_set1_epi16(5);
+    const __m256i ten = _mm256_set1_epi16(10);
+    const __m256i recip = _mm256_set1_epi16(GRAY_RECIP);
+    __m256i r, g, b, sum[2], quot, tie[2], result[2], out, mask;
+    __m128i fixed;
+    int j, k, half;
+
+    for (j = 0; j + 32 <= cols; j += 32)
+    {
+        r = _mm256_loadu_si256((const __m256i*)(red + j));
+        g = _mm256_loadu_si256((const __m256i*)(green + j));
+        b = _mm256_loadu_si256((const __m256i*)(blue + j));
+
+        // 10 * luminance = 3r + 6g + b, exact in 16 bits
+        for (half = 0; half < 2; half++)
+        {
+            __m256i r16 = half ? _mm256_unpackhi_epi8(r, zero) : _mm256_unpacklo_epi8(r, zero);
+            __m256i g16 = half ? _mm256_unpackhi_epi8(g, zero) : _mm256_unpacklo_epi8(g, zero);
+            __m256i b16 = half ? _mm256_unpackhi_epi8(b, zero) : _mm256_unpacklo_epi8(b, zero);
+            __m256i g2 = _mm256_add_epi16(g16, g16);
+
+            sum[half] = _mm256_add_epi16(_mm256_add_epi16(r16, _mm256_add_epi16(r16, r16)),
+                _mm256_add_epi16(_mm256_add_epi16(g2, g2), _mm256_add_epi16(g2, b16)));
+            quot = _mm256_mulhi_epu16(sum[half], recip);
+            tie[half] = _mm256_cmpeq_epi16(_mm256_sub_epi16(sum[half],
+                _mm256_mullo_epi16(quot, ten)), five);
+            result[half] = _mm256_mulhi_epu16(_mm256_add_epi16(sum[half], five), recip);
+        }
+
+        out = _mm256_packus_epi16(result[0], result[1]);
+        mask = _mm256_packs_epi16(tie[0], tie[1]);
+
+        // halves with ties redo them in double precision
+        for (k = 0; k < 2; k++)
+        {
+            if (_mm_movemask_epi8(k ? _mm256_extracti128_si256(mask, 1)
+                : _mm256_castsi256_si128(mask)) == 0) continue;
+
+            fixed = grayTieAVX2(_mm_loadu_si128((const __m128i*)(red + j + 16 * k)),
+                _mm_loadu_si128((const __m128i*)(green + j + 16 * k)),
+                _mm_loadu_si128((const __m128i*)(blue + j + 16 * k)));
+            out = _mm256_blendv_epi8(out, k ? _mm256_inserti128_si256(out, fixed, 1)
+                : _mm256_inserti128_si256(out, fixed, 0), mask);
+        }
+        _mm256_storeu_si256((__m256i*)(gray + j), out);
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts a row of color values to grayscale 16 at a time with SSE2. See
+ * grayscaleBands for how the values are computed.
+ *
+ * @param[in] red - row of red color values
+ * @param[in] green - row of green color values
+ * @param[in] blue - row of blue color values
+ * @param[out] gray - row of gray values, may be the same as red
+ * @param[in] cols - columns in the row
+ *
+ * @returns returns the number of columns converted, a multiple of 16
+ *
+ *****************************************************************************/
+TARGET_SSE2 static int grayRowSSE2(const pixel* red, const pixel* green,
+    const pixel* blue, pixel* gray, int cols)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i five = _mm_set1_epi16(5);
+    const __m128i ten = _mm_set1_epi16(10);
+    const __m128i recip = _mm_set1_epi16(GRAY_RECIP);
+    __m128i r, g, b, sum[2], quot, tie[2], result[2], out, mask;
+    int j, half;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        r = _mm_loadu_si128((const __m128i*)(red + j));
+        g = _mm_loadu_si128((const __m128i*)(green + j));
+        b = _mm_loadu_si128((const __m128i*)(blue + j));
+
+        // 10 * luminance = 3r + 6g + b, exact in 16 bits
+        for (half = 0; half < 2; half++)
+        {
+            __m128i r16 = half ? _mm_unpackhi_epi8(r, zero) : _mm_unpacklo_epi8(r, zero);
+            __m128i g16 = half ? _mm_unpackhi_epi8(g, zero) : _mm_unpacklo_epi8(g, zero);
+            __m128i b16 = half ? _mm_unpackhi_epi8(b, zero) : _mm_unpacklo_epi8(b, zero);
+            __m128i g2 = _mm_add_epi16(g16, g16);
+
+            sum[half] = _mm_add_epi16(_mm_add_epi16(r16, _mm_add_epi16(r16, r16)),
+                _mm_add_epi16(_mm_add_epi16(g2, g2), _mm_add_epi16(g2, b16)));
+            quot = _mm_mulhi_epu16(sum[half], recip);
+            tie[half] = _mm_cmpeq_epi16(_mm_sub_epi16(sum[half],
+                _mm_mullo_epi16(quot, ten)), five);
+            result[half] = _mm_mulhi_epu16(_mm_add_epi16(sum[half], five), recip);
+        }
+
+        out = _mm_packus_epi16(result[0], result[1]);
+        mask = _mm_packs_epi16(tie[0], tie[1]);
+
+        // rows of colors with ties redo them in double precision
+        if (_mm_movemask_epi8(mask) != 0)
+        {
+            out = _mm_or_si128(_mm_andnot_si128(mask, out),
+                _mm_and_si128(mask, grayTieSSE2(r, g, b)));
+        }
+        _mm_storeu_si128((__m128i*)(gray + j), out);
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Takes the larger or smaller of two rows of color values 32 at a time
+ * with AVX2
+ *
+ * @param[out] out - row of results, may be the same as a or b
+ * @param[in] a - first row
+ * @param[in] b - second row
+ * @param[in] cols - columns in the rows
+ * @param[in] maximum - true for the larger value, false for the smaller
+ *
+ * @returns returns the number of columns done, a multiple of 32
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int extremeRowAVX2(pixel* out, const pixel* a,
+    const pixel* b, int cols, bool maximum)
+{
+    __m256i x, y;
+    int j;
+
+    for (j = 0; j + 32 <= cols; j += 32)
+    {
+        x = _mm256_loadu_si256((const __m256i*)(a + j));
+        y = _mm256_loadu_si256((const __m256i*)(b + j));
+        x = maximum ? _mm256_max_epu8(x, y) : _mm256_min_epu8(x, y);
+        _mm256_storeu_si256((__m256i*)(out + j), x);
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Takes the larger or smaller of two rows of color values 16 at a time
+ * with SSE2
+ *
+ * @param[out] out - row of results, may be the same as a or b
+ * @param[in] a - first row
+ * @param[in] b - second row
+ * @param[in] cols - columns in the rows
+ * @param[in] maximum - true for the larger value, false for the smaller
+ *
+ * @returns returns the number of columns done, a multiple of 16
+ *
+ *****************************************************************************/
+TARGET_SSE2 static int extremeRowSSE2(pixel* out, const pixel* a,
+    const pixel* b, int cols, bool maximum)
+{
+    __m128i x, y;
+    int j;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        x = _mm_loadu_si128((const __m128i*)(a + j));
+        y = _mm_loadu_si128((const __m128i*)(b + j));
+        x = maximum ? _mm_max_epu8(x, y) : _mm_min_epu8(x, y);
+        _mm_storeu_si128((__m128i*)(out + j), x);
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Running sums of a row of color values, or of their squares, added to a
+ * row of sums above, 16 at a time with AVX2. Each half of a register is
+ * summed in two shifted adds, the low half's total is carried into the
+ * high half, and the total so far into both.
+ *
+ * @param[out] out - running sums
+ * @param[in] above - sums to add in, nullptr for none
+ * @param[in] row - row of color values
+ * @param[in] cols - columns in the row
+ * @param[in] squares - true to sum the squares of the color values
+ *
+ * @returns returns the number of columns done, a multiple of 16
+ *
+ *****************************************************************************/
+TARGET_AVX2 static int prefixRowAVX2(uint32_t* out, const uint32_t* above,
+    const pixel* row, int cols, bool squares)
+{
+    const __m256i last = _mm256_set1_epi32(7);
+    __m256i x, carry = _mm256_setzero_si256();
+    __m128i bytes;
+    int j, half;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        bytes = _mm_loadu_si128((const __m128i*)(row + j));
+        for (half = 0; half < 2; half++)
+        {
+            x = _mm256_cvtepu8_epi32(half ? _mm_srli_si128(bytes, 8) : bytes);
+            if (squares)
+            {
+                x = _mm256_mullo_epi32(x, x);
+            }
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+            x = _mm256_add_epi32(x, _mm256_shuffle_epi32(
+                _mm256_permute2x128_si256(x, x, 0x08), 0xFF));
+            x = _mm256_add_epi32(x, carry);
+            carry = _mm256_permutevar8x32_epi32(x, last);
+            if (above != nullptr)
+            {
+                x = _mm256_add_epi32(x, _mm256_loadu_si256(
+                    (const __m256i*)(above + j + 8 * half)));
+            }
+            _mm256_storeu_si256((__m256i*)(out + j + 8 * half), x);
+        }
+    }
+
+    return j;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Running sums of a row of color values, or of their squares, added to a
+ * row of sums above, 16 at a time with SSE2. Each group of four is summed
+ * in two shifted adds and the total so far added in.
+ *
+ * @param[out] out - running sums
+ * @param[in] above - sums to add in, nullptr for none
+ * @param[in] row - row of color values
+ * @param[in] cols - columns in the row
+ * @param[in] squares - true to sum the squares of the color values
+ *
+ * @returns returns the number of columns done, a multiple of 16
+ *
+ *****************************************************************************/
+TARGET_SSE2 static int prefixRowSSE2(uint32_t* out, const uint32_t* above,
+    const pixel* row, int cols, bool squares)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bytes, words[2], x, carry = _mm_setzero_si128();
+    int j, k;
+
+    for (j = 0; j + 16 <= cols; j += 16)
+    {
+        bytes = _mm_loadu_si128((const __m128i*)(row + j));
+        words[0] = _mm_unpacklo_epi8(bytes, zero);
+        words[1] = _mm_unpackhi_epi8(bytes, zero);
+        for (k = 0; k < 4; k++)
+        {
+            // 255 * 255 still fits an unsigned 16 bit product
+            x = words[k / 2];
+            if (squares)
+            {
+                x = _mm_mullo_epi16(x, x);
+            }
+            x = k % 2 ? _mm_unpackhi_epi16(x, zero) : _mm_unpacklo_epi16(x, zero);
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, carry);
+            carry = _mm_shuffle_epi32(x, 0xFF);
+            if (above != nullptr)
+            {
+                x = _mm_add_epi32(x, _mm_loadu_si128(
+                    (const __m128i*)(above + j + 4 * k)));
+            }
+            _mm_storeu_si128((__m128i*)(out + j + 4 * k), x);
+        }
+    }
+
+    return j;
+}
+
+#endif
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Negates every color value in a colorband
+ *
+ * @param[in,out] colorband - the colorband to change
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ *
+ *****************************************************************************/
+void negateBand(pixel** colorband, int rows, int cols)
+{
+    simdLevel level = detectSimd();
+    int i, j;
+
+    if (colorband == nullptr) return;
+
+    for (i = 0; i < rows; i++)
+    {
+        j = 0;
+#ifdef SIMD_X86
+        if (level == SIMD_AVX2)
+        {
+            j = negateRowAVX2(colorband[i], cols);
+        }
+        else if (level == SIMD_SSE2)
+        {
+            j = negateRowSSE2(colorband[i], cols);
+        }
+#endif
+        for (; j < cols; j++)
+        {
+            colorband[i][j] = 255 - colorband[i][j];
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Adds a value to every color value in a colorband, cropping the results to
+ * [0, 255]
+ *
+ * @param[in,out] colorband - the colorband to change
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ * @param[in] value - value to be added to color values
+ *
+ *****************************************************************************/
+void brightenBand(pixel** colorband, int rows, int cols, int value)
+{
+    simdLevel level = detectSimd();
+    int amount = min(abs(value), 255);
+    bool add = value > 0;
+    int i, j;
+
+    if (colorband == nullptr || value == 0) return;
+
+    for (i = 0; i < rows; i++)
+    {
+        j = 0;
+#ifdef SIMD_X86
+        if (level == SIMD_AVX2)
+        {
+            j = addRowAVX2(colorband[i], cols, amount, add);
+        }
+        else if (level == SIMD_SSE2)
+        {
+            j = addRowSSE2(colorband[i], cols, amount, add);
+        }
+#endif
+        for (; j < cols; j++)
+        {
+            colorband[i][j] = cropNum(colorband[i][j] + value);
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Converts three colorbands to grayscale with 0.3 red + 0.6 green + 0.1 blue,
+ * rounded. Ten times that is 3 red + 6 green + blue, which is computed in
+ * integers and divided by 10 with a multiply by GRAY_RECIP and a 16 bit
+ * shift. The result matches the double precision formula except for values
+ * exactly halfway between two integers, which grayTie settles.
+ *
+ * @param[in] red - red colorband
+ * @param[in] green - green colorband
+ * @param[in] blue - blue colorband
+ * @param[out] gray - gray colorband, may be the same as red
+ * @param[in] rows - rows in the colorbands
+ * @param[in] cols - columns in the colorbands
+ *
+ *****************************************************************************/
+void grayscaleBands(pixel** red, pixel** green, pixel** blue, pixel** gray,
+    int rows, int cols)
+{
+    simdLevel level = detectSimd();
+    int i, j;
+
+    for (i = 0; i < rows; i++)
+    {
+        j = 0;
+#ifdef SIMD_X86
+        if (level == SIMD_AVX2)
+        {
+            j = grayRowAVX2(red[i], green[i], blue[i], gray[i], cols);
+        }
+        else if (level == SIMD_SSE2)
+        {
+            j = grayRowSSE2(red[i], green[i], blue[i], gray[i], cols);
+        }
+#endif
+        for (; j < cols; j++)
+        {
+            gray[i][j] = grayValue(red[i][j], green[i][j], blue[i][j]);
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets each color value of a row to the larger or smaller of the values in
+ * the same column of two rows
+ *
+ * @param[out] out - row of results, may be the same as a or b
+ * @param[in] a - first row
+ * @param[in] b - second row
+ * @param[in] cols - columns in the rows
+ * @param[in] maximum - true for the larger value, false for the smaller
+ *
+ *****************************************************************************/
+void extremeRow(pixel* out, const pixel* a, const pixel* b, int cols,
+    bool maximum)
+{
+    simdLevel level = detectSimd();
+    int j = 0;
+
+#ifdef SIMD_X86
+    if (level == SIMD_AVX2)
+    {
+        j = extremeRowAVX2(out, a, b, cols, maximum);
+    }
+    else if (level == SIMD_SSE2)
+    {
+        j = extremeRowSSE2(out, a, b, cols, maximum);
+    }
+#endif
+    for (; j < cols; j++)
+    {
+        out[j] = maximum ? max(a[j], b[j]) : min(a[j], b[j]);
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets each entry of a row to the sum of the color values, or of their
+ * squares, up to and including its column, plus the entry above it. The
+ * sums of a row must fit in 32 bits.
+ *
+ * @param[out] out - running sums
+ * @param[in] above - sums to add in, nullptr for none
+ * @param[in] row - row of color values
+ * @param[in] cols - columns in the row
+ * @param[in] squares - true to sum the squares of the color values
+ *
+ *****************************************************************************/
+void prefixRow(uint32_t* out, const uint32_t* above, const pixel* row,
+    int cols, bool squares)
+{
+    simdLevel level = detectSimd();
+    uint32_t sum = 0;
+    int j = 0;
+
+#ifdef SIMD_X86
+    if (level == SIMD_AVX2)
+    {
+        j = prefixRowAVX2(out, above, row, cols, squares);
+    }
+    else if (level == SIMD_SSE2)
+    {
+        j = prefixRowSSE2(out, above, row, cols, squares);
+    }
+    if (j > 0)
+    {
+        sum = out[j - 1] - (above != nullptr ? above[j - 1] : 0);
+    }
+#endif
+    for (; j < cols; j++)
+    {
+        sum += squares ? row[j] * row[j] : row[j];
+        out[j] = sum + (above != nullptr ? above[j] : 0);
+    }
+}
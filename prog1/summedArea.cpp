@@ -0,0 +1,325 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief The source code for summed-area tables, which give the sum of the
+ * color values in any rectangle of a colorband from four entries
+ ****************************************************************************/
+
+#include "netPBM.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Decides if the sums of a colorband fit in 32 bits
+ *
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ * @param[in] squares - true for the sums of the squares of the color values
+ *
+ * @returns returns true if the total of the whole colorband fits
+ *
+ *****************************************************************************/
+static bool sumFits(int rows, int cols, bool squares)
+{
+    uint64_t largest = squares ? 255 * 255 : 255;
+
+    return (uint64_t)rows * cols * largest <= UINT32_MAX;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets a row of 32 bit sums to the running sums of a row of color values
+ * plus the row above
+ *
+ * @param[out] out - row of sums, from column 1
+ * @param[in] above - row of sums above, from column 1, nullptr for none
+ * @param[in] row - row of color values
+ * @param[in] cols - columns in the row
+ * @param[in] squares - true to sum the squares of the color values
+ * @param[in] scratch - unused
+ *
+ *****************************************************************************/
+static void sumRow(uint32_t* out, const uint32_t* above, const pixel* row,
+    int cols, bool squares, vector<uint32_t>&)
+{
+    prefixRow(out, above, row, cols, squares);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets a row of 64 bit sums to the running sums of a row of color values
+ * plus the row above. The row's own sums are found 32 bits wide when they
+ * fit and widened as the row above is added.
+ *
+ * @param[out] out - row of sums, from column 1
+ * @param[in] above - row of sums above, from column 1, nullptr for none
+ * @param[in] row - row of color values
+ * @param[in] cols - columns in the row
+ * @param[in] squares - true to sum the squares of the color values
+ * @param[in] scratch - cols 32 bit sums of scratch space
+ *
+ *****************************************************************************/
+static void sumRow(uint64_t* out, const uint64_t* above, const pixel* row,
+    int cols, bool squares, vector<uint32_t>& scratch)
+{
+    uint64_t sum = 0;
+    int j;
+
+    if (sumFits(1, cols, squares))
+    {
+        prefixRow(scratch.data(), nullptr, row, cols, squares);
+        for (j = 0; j < cols; j++)
+        {
+            out[j] = scratch[j] + (above != nullptr ? above[j] : 0);
+        }
+        return;
+    }
+
+    for (j = 0; j < cols; j++)
+    {
+        sum += squares ? row[j] * row[j] : row[j];
+        out[j] = sum + (above != nullptr ? above[j] : 0);
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Fills a summed-area table of a colorband. The rows are split into one
+ * band per thread and each band is summed as if it started the image.
+ * The last row of each band then has the bands above it added in, one row
+ * at a time down the bands, and every other row of each band has the
+ * finished last row of the band above it added in, all bands at once.
+ *
+ * @param[out] table - rows + 1 by cols + 1 sums
+ * @param[in] colorband - the colorband
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ * @param[in] squares - true to sum the squares of the color values
+ *
+ *****************************************************************************/
+template <class T>
+static void fillSums(T** table, pixel** colorband, int rows, int cols,
+    bool squares)
+{
+    int threads = threadCount(rows), k, j;
+    vector<int> start(threads + 1, rows);
+
+    memset(table[0], 0, (cols + 1) * sizeof(T));
+
+    // table row i + 1 holds the sums through colorband row i
+    parallelRows(rows, threads, [&](int first, int last, int t)
+    {
+        vector<uint32_t> scratch(cols);
+        int i;
+
+        start[t] = first;
+        for (i = first; i < last; i++)
+        {
+            table[i + 1][0] = 0;
+            sumRow(table[i + 1] + 1, i == first ? nullptr : table[i] + 1,
+                colorband[i], cols, squares, scratch);
+        }
+    });
+
+    for (k = 1; k < threads; k++)
+    {
+        T* carry = table[start[k]];
+        T* last = table[start[k + 1]];
+
+        if (start[k] == start[k + 1]) continue;
+        for (j = 1; j <= cols; j++)
+        {
+            last[j] += carry[j];
+        }
+    }
+
+    parallelRows(threads, threads, [&](int first, int last, int)
+    {
+        int b, i, j;
+
+        for (b = max(first, 1); b < last; b++)
+        {
+            const T* carry = table[start[b]];
+
+            for (i = start[b] + 1; i < start[b + 1]; i++)
+            {
+                for (j = 1; j <= cols; j++)
+                {
+                    table[i][j] += carry[j];
+                }
+            }
+        }
+    });
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Builds the summed-area table of a colorband, and of the squares of its
+ * color values if asked. The sums are 32 bits wide unless the colorband's
+ * total could need more.
+ *
+ * @param[in] colorband - the colorband
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ * @param[in] squares - true to also sum the squares of the color values
+ *
+ * @returns returns the table, to be freed with freeSummedArea
+ *
+ *****************************************************************************/
+summedArea buildSummedArea(pixel** colorband, int rows, int cols, bool squares)
+{
+    summedArea table = { rows, cols, nullptr, nullptr, nullptr, nullptr };
+
+    if (sumFits(rows, cols, false))
+    {
+        alloc2DSum(table.sum32, rows + 1, cols + 1);
+        fillSums(table.sum32, colorband, rows, cols, false);
+    }
+    else {
+        alloc2DSum(table.sum64, rows + 1, cols + 1);
+        fillSums(table.sum64, colorband, rows, cols, false);
+    }
+
+    if (!squares) return table;
+
+    if (sumFits(rows, cols, true))
+    {
+        alloc2DSum(table.square32, rows + 1, cols + 1);
+        fillSums(table.square32, colorband, rows, cols, true);
+    }
+    else {
+        alloc2DSum(table.square64, rows + 1, cols + 1);
+        fillSums(table.square64, colorband, rows, cols, true);
+    }
+
+    return table;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Frees the arrays of a summed-area table
+ *
+ * @param[in,out] table - the table
+ *
+ *****************************************************************************/
+void freeSummedArea(summedArea& table)
+{
+    free2DSum(table.sum32);
+    free2DSum(table.sum64);
+    free2DSum(table.square32);
+    free2DSum(table.square64);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Adds up a rectangle of a table from its four corners. Differences of
+ * unsigned sums wrap around, so the answer is right whenever it fits.
+ *
+ * @param[in] table - 2D array of sums
+ * @param[in] top - first row of the rectangle
+ * @param[in] left - first column of the rectangle
+ * @param[in] bottom - one past the last row of the rectangle
+ * @param[in] right - one past the last column of the rectangle
+ *
+ * @returns returns the sum of the rectangle
+ *
+ *****************************************************************************/
+template <class T>
+static uint64_t cornerSum(T** table, int top, int left, int bottom, int right)
+{
+    T sum = table[bottom][right] - table[top][right] - table[bottom][left]
+        + table[top][left];
+
+    return sum;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the sum of the color values in a rectangle of the colorband
+ *
+ * @param[in] table - summed-area table of the colorband
+ * @param[in] top - first row of the rectangle
+ * @param[in] left - first column of the rectangle
+ * @param[in] bottom - one past the last row of the rectangle
+ * @param[in] right - one past the last column of the rectangle
+ *
+ * @returns returns the sum of the rectangle
+ *
+ *****************************************************************************/
+uint64_t areaSum(const summedArea& table, int top, int left, int bottom,
+    int right)
+{
+    if (table.sum32 != nullptr)
+    {
+        return cornerSum(table.sum32, top, left, bottom, right);
+    }
+    return cornerSum(table.sum64, top, left, bottom, right);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the sum of the squares of the color values in a rectangle of the
+ * colorband. The table must have been built with squares.
+ *
+ * @param[in] table - summed-area table of the colorband
+ * @param[in] top - first row of the rectangle
+ * @param[in] left - first column of the rectangle
+ * @param[in] bottom - one past the last row of the rectangle
+ * @param[in] right - one past the last column of the rectangle
+ *
+ * @returns returns the sum of the squares in the rectangle
+ *
+ *****************************************************************************/
+uint64_t areaSquares(const summedArea& table, int top, int left, int bottom,
+    int right)
+{
+    if (table.square32 != nullptr)
+    {
+        return cornerSum(table.square32, top, left, bottom, right);
+    }
+    return cornerSum(table.square64, top, left, bottom, right);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Predicts the bytes buildSummedArea uses for a colorband
+ *
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ * @param[in] squares - true if the squares are summed too
+ *
+ * @returns returns the predicted bytes
+ *
+ *****************************************************************************/
+size_t summedAreaBytes(int rows, int cols, bool squares)
+{
+    size_t bytes = sumBytes(rows + 1, cols + 1,
+        sumFits(rows, cols, false) ? sizeof(uint32_t) : sizeof(uint64_t));
+
+    if (squares)
+    {
+        bytes += sumBytes(rows + 1, cols + 1,
+            sumFits(rows, cols, true) ? sizeof(uint32_t) : sizeof(uint64_t));
+    }
+
+    return bytes;
+}
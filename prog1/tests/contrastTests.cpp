@@ -0,0 +1,90 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief Tests that contrasting an image whose clip percentiles land on the
+ * same gray value leaves it alone. Built apart from prog1:
+ *
+ *     g++ -O2 -std=c++14 -pthread -I.. contrastTests.cpp
+ *         ../colorSpace.cpp ../histogram.cpp ../imageFileIO.cpp
+ *         ../imageOperations.cpp ../memory.cpp ../pointOperations.cpp
+ *         ../simdKernels.cpp ../summedArea.cpp ../tiling.cpp
+ *         ../utilities.cpp -o contrastTests
+ ****************************************************************************/
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
+#include "../../catch.hpp"
+#include "netPBM.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes a flat gray color image with a few hot and dead pixels
+ *
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ * @param[in] value - color value of the flat pixels
+ *
+ * @returns returns the image
+ *
+ *****************************************************************************/
+static image flatImage(int rows, int cols, pixel value)
+{
+    pixel** bands[3];
+    image img;
+    int c, i, j;
+
+    img.rows = rows;
+    img.cols = cols;
+    for (c = 0; c < 3; c++)
+    {
+        bands[c] = alloc2D(rows, cols);
+        for (i = 0; i < rows; i++)
+        {
+            for (j = 0; j < cols; j++)
+            {
+                bands[c][i][j] = value;
+            }
+        }
+        bands[c][0][0] = 255;
+        bands[c][rows / 2][cols / 3] = 255;
+        bands[c][rows - 1][cols - 1] = 0;
+    }
+    img.redgray = bands[0];
+    img.green = bands[1];
+    img.blue = bands[2];
+
+    return img;
+}
+
+TEST_CASE("stretchTable leaves a single value alone")
+{
+    pointTable table = stretchTable(100, 100);
+    int i;
+
+    for (i = 0; i < 256; i++)
+    {
+        REQUIRE(table.value[i] == i);
+    }
+}
+
+TEST_CASE("contrast with clipping keeps a flat image with hot pixels")
+{
+    image img = flatImage(64, 48, 100);
+    long wrong = 0;
+    int i, j;
+
+    imageContrast(img, 1);
+
+    for (i = 0; i < img.rows; i++)
+    {
+        for (j = 0; j < img.cols; j++)
+        {
+            if (img.redgray[i][j] != 100) wrong++;
+        }
+    }
+    free2D(img.redgray, img.rows);
+
+    REQUIRE(wrong == 3);
+}
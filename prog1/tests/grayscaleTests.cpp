@@ -0,0 +1,120 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief Tests that grayscaleBands and grayValue match the double rounding
+ * of 0.3 red + 0.6 green + 0.1 blue for every color. Built apart from prog1:
+ *
+ *     g++ -O2 -std=c++14 -pthread -I.. grayscaleTests.cpp
+ *         ../colorSpace.cpp ../histogram.cpp ../imageFileIO.cpp
+ *         ../imageOperations.cpp ../memory.cpp ../pointOperations.cpp
+ *         ../simdKernels.cpp ../summedArea.cpp ../tiling.cpp
+ *         ../utilities.cpp -o grayscaleTests
+ ****************************************************************************/
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
+#include "../../catch.hpp"
+#include "netPBM.h"
+#include "pixelExpr.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the gray value of a color the way the original scalar code did
+ *
+ * @param[in] r - red color value
+ * @param[in] g - green color value
+ * @param[in] b - blue color value
+ *
+ * @returns returns the gray value
+ *
+ *****************************************************************************/
+static pixel expectedGray(int r, int g, int b)
+{
+    return cropNum((int)round(0.3 * r + 0.6 * g + 0.1 * b));
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Counts the gray values of an image that differ from expectedGray. Each
+ * row holds one red and green pair and every blue value, so 256 * 256 rows
+ * cover every color. The columns run past 256 so the vector kernels' tails
+ * are reached at a different blue value on each row.
+ *
+ * @param[in] inPlace - true to write the gray values over the red band
+ *
+ * @returns returns the number of wrong gray values
+ *
+ *****************************************************************************/
+static long grayMismatches(bool inPlace)
+{
+    int rows = 256 * 256, cols = 256 + 13, i, j;
+    pixel** red = alloc2D(rows, cols);
+    pixel** green = alloc2D(rows, cols);
+    pixel** blue = alloc2D(rows, cols);
+    pixel** gray = inPlace ? red : alloc2D(rows, cols);
+    long wrong = 0;
+
+    for (i = 0; i < rows; i++)
+    {
+        for (j = 0; j < cols; j++)
+        {
+            red[i][j] = (pixel)(i >> 8);
+            green[i][j] = (pixel)(i & 255);
+            blue[i][j] = (pixel)((j * 7 + i) & 255);
+        }
+    }
+
+    grayscaleBands(red, green, blue, gray, rows, cols);
+
+    for (i = 0; i < rows; i++)
+    {
+        for (j = 0; j < cols; j++)
+        {
+            if (gray[i][j] != expectedGray(i >> 8, i & 255,
+                (j * 7 + i) & 255))
+            {
+                wrong++;
+            }
+        }
+    }
+
+    if (!inPlace) free2D(gray, rows);
+    free2D(red, rows);
+    free2D(green, rows);
+    free2D(blue, rows);
+
+    return wrong;
+}
+
+TEST_CASE("grayscaleBands rounds every color like the double formula")
+{
+    REQUIRE(grayMismatches(false) == 0);
+}
+
+TEST_CASE("grayscaleBands rounds every color in place")
+{
+    REQUIRE(grayMismatches(true) == 0);
+}
+
+TEST_CASE("grayValue rounds every color like the double formula")
+{
+    long wrong = 0;
+    int r, g, b;
+
+    for (r = 0; r < 256; r++)
+    {
+        for (g = 0; g < 256; g++)
+        {
+            for (b = 0; b < 256; b++)
+            {
+                if (grayValue(r, g, b) != expectedGray(r, g, b)) wrong++;
+            }
+        }
+    }
+
+    REQUIRE(wrong == 0);
+}
@@ -0,0 +1,127 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief Tests that imageHistogram and grayscaleHistogram count the same as
+ * a plain loop over the pixels. Built apart from prog1:
+ *
+ *     g++ -O2 -std=c++14 -pthread -I.. histogramTests.cpp
+ *         ../colorSpace.cpp ../histogram.cpp ../imageFileIO.cpp
+ *         ../imageOperations.cpp ../memory.cpp ../pointOperations.cpp
+ *         ../simdKernels.cpp ../summedArea.cpp ../tiling.cpp
+ *         ../utilities.cpp -o histogramTests
+ ****************************************************************************/
+
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
+#include "../../catch.hpp"
+#include "netPBM.h"
+#include "pixelExpr.h"
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes a color image of made up values. The columns are not a multiple of
+ * 16 so the counting loop's tail is reached, and one corner is all one
+ * value so long runs are counted too.
+ *
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ *
+ * @returns returns the image
+ *
+ *****************************************************************************/
+static image testImage(int rows, int cols)
+{
+    pixel** bands[3];
+    unsigned seed = 12345;
+    image img;
+    int c, i, j;
+
+    img.rows = rows;
+    img.cols = cols;
+    for (c = 0; c < 3; c++)
+    {
+        bands[c] = alloc2D(rows, cols);
+        for (i = 0; i < rows; i++)
+        {
+            for (j = 0; j < cols; j++)
+            {
+                seed = seed * 1103515245 + 12345;
+                bands[c][i][j] = i < rows / 4 && j < cols / 4 ? (pixel)(40 * c)
+                    : (pixel)(seed >> 16);
+            }
+        }
+    }
+    img.redgray = bands[0];
+    img.green = bands[1];
+    img.blue = bands[2];
+
+    return img;
+}
+
+TEST_CASE("imageHistogram counts each colorband like a plain loop")
+{
+    image img = testImage(301, 517);
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    size_t expected[3][256] = {};
+    long wrong = 0;
+    int c, i, j;
+
+    for (c = 0; c < 3; c++)
+    {
+        for (i = 0; i < img.rows; i++)
+        {
+            for (j = 0; j < img.cols; j++)
+            {
+                expected[c][bands[c][i][j]]++;
+            }
+        }
+    }
+
+    histogram hist = imageHistogram(img);
+
+    REQUIRE(hist.channels == 3);
+    REQUIRE(hist.pixels == (size_t)img.rows * img.cols);
+    for (c = 0; c < 3; c++)
+    {
+        for (i = 0; i < 256; i++)
+        {
+            if (hist.count[c][i] != expected[c][i]) wrong++;
+        }
+    }
+    REQUIRE(wrong == 0);
+
+    for (c = 0; c < 3; c++)
+    {
+        free2D(bands[c], img.rows);
+    }
+}
+
+TEST_CASE("grayscaleHistogram counts the gray values like a plain loop")
+{
+    image img = testImage(301, 517);
+    size_t expected[256] = {};
+    long wrong = 0;
+    int i, j;
+
+    for (i = 0; i < img.rows; i++)
+    {
+        for (j = 0; j < img.cols; j++)
+        {
+            expected[grayValue(img.redgray[i][j], img.green[i][j],
+                img.blue[i][j])]++;
+        }
+    }
+
+    histogram hist = grayscaleHistogram(img);
+
+    REQUIRE(hist.channels == 1);
+    for (i = 0; i < 256; i++)
+    {
+        if (hist.count[0][i] != expected[i]) wrong++;
+    }
+    REQUIRE(wrong == 0);
+
+    free2D(img.redgray, img.rows);
+}
@@ -0,0 +1,594 @@
+/** **************************************************************************
+ * @file
+ *
+ * @brief The source code for running stencils, operations where each new
+ * color value depends on the old values around it, over small tiles of an
+ * image so the rows around a tile are still in cache when they are reused.
+ * Stencils run one after another are fused into a pipeline that keeps only
+ * the few rows each stage needs.
+ ****************************************************************************/
+
+#include "netPBM.h"
+
+/**
+ * @brief Rows in a tile
+ */
+static int tileRows = TILE_ROWS;
+/**
+ * @brief Columns in a tile
+ */
+static int tileCols = TILE_COLS;
+/**
+ * @brief How stencils treat the edge of the image
+ */
+static borderMode border = BLACK_BORDER;
+
+/**
+ * @brief Unaltered color values one thread keeps for one colorband while it
+ * alters its rows of the image in place
+ */
+struct stencilSaves
+{
+    vector<pixel> left;      /**< Columns left of a tile, altered by the tile before it */
+    vector<pixel> above;     /**< Rows above the current row of tiles */
+    vector<pixel> nextAbove; /**< Rows above the next row of tiles */
+    vector<pixel> below;     /**< Rows below the thread's rows, altered by another thread */
+    vector<pixel> leftPad;   /**< Columns left of the image for the current row of tiles */
+    vector<pixel> rightPad;  /**< Columns right of the image for the current row of tiles */
+};
+
+/**
+ * @brief Rows one thread keeps for one stage of a line buffered pipeline:
+ * the last rows of the stage's output, for the next stage to read, and the
+ * rows of its input around the row being made
+ */
+struct lineBuffer
+{
+    vector<pixel> rows;    /**< Slots of output rows, a padded row per colorband */
+    vector<int> index;     /**< Image row in each slot, -1 for none */
+    vector<size_t> used;   /**< When each slot was last read */
+    vector<pixel> zero;    /**< Padded input row of 0s, for rows outside the image */
+    vector<pixel*> window; /**< Input rows around the row being made, a colorband at a time */
+    vector<pixel**> in;    /**< Center of the window of each input colorband */
+    int pad;               /**< Columns filled in on each side of an output row */
+    int stride;            /**< Distance from one padded output row to the next */
+};
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets the size of the tiles stencils are run over. A tile and the rows
+ * and columns around it should fit in the L2 cache.
+ *
+ * @param[in] rows - rows in a tile
+ * @param[in] cols - columns in a tile
+ *
+ *****************************************************************************/
+void setTileSize(int rows, int cols)
+{
+    tileRows = max(rows, 1);
+    tileCols = max(cols, 1);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets how stencils treat the edge of the image
+ *
+ * @param[in] mode - border mode
+ *
+ *****************************************************************************/
+void setBorderMode(borderMode mode)
+{
+    border = mode;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Gets how stencils treat the edge of the image
+ *
+ * @returns returns the border mode
+ *
+ *****************************************************************************/
+borderMode getBorderMode()
+{
+    return border;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds the row or column inside the image a position outside it reads
+ * from. Clamp repeats the edge, mirror reflects about the edge without
+ * repeating it and wrap reads from the other side of the image.
+ *
+ * @param[in] x - row or column, may be outside the image
+ * @param[in] n - rows or columns in the image
+ *
+ * @returns returns the row or column in [0, n)
+ *
+ *****************************************************************************/
+static int borderIndex(int x, int n)
+{
+    if (border == CLAMP_BORDER) return min(max(x, 0), n - 1);
+    if (border == WRAP_BORDER) return (x % n + n) % n;
+    if (n == 1) return 0;
+
+    while (x < 0 || x >= n)
+    {
+        x = x < 0 ? -x : 2 * (n - 1) - x;
+    }
+    return x;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Copies columns of a row, filling the columns outside the image by the
+ * border mode. Zero and black borders read as 0 outside the image.
+ *
+ * @param[out] to - count color values
+ * @param[in] row - the whole row
+ * @param[in] first - first column to copy, may be negative
+ * @param[in] count - number of columns to copy
+ * @param[in] cols - columns in the row
+ *
+ *****************************************************************************/
+static void borderCopy(pixel* to, const pixel* row, int first, int count,
+    int cols)
+{
+    int lo = min(max(first, 0), cols), hi = max(min(first + count, cols), lo);
+    int j;
+
+    for (j = first; j < lo; j++)
+    {
+        *to++ = border == BLACK_BORDER || border == ZERO_BORDER ? 0
+            : row[borderIndex(j, cols)];
+    }
+    memcpy(to, row + lo, hi - lo);
+    to += hi - lo;
+    for (j = max(hi, first); j < first + count; j++)
+    {
+        *to++ = border == BLACK_BORDER || border == ZERO_BORDER ? 0
+            : row[borderIndex(j, cols)];
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Copies columns of a row of a colorband, filling rows and columns outside
+ * the image by the border mode
+ *
+ * @param[out] to - count color values
+ * @param[in] colorband - the colorband
+ * @param[in] i - row to copy, may be outside the image
+ * @param[in] first - first column to copy, may be negative
+ * @param[in] count - number of columns to copy
+ * @param[in] rows - rows in the colorband
+ * @param[in] cols - columns in the colorband
+ *
+ *****************************************************************************/
+void borderRow(pixel* to, pixel** colorband, int i, int first, int count,
+    int rows, int cols)
+{
+    if (i < 0 || i >= rows)
+    {
+        if (border == BLACK_BORDER || border == ZERO_BORDER)
+        {
+            memset(to, 0, count);
+            return;
+        }
+        i = borderIndex(i, rows);
+    }
+
+    borderCopy(to, colorband[i], first, count, cols);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Runs a stencil over an image one tile at a time, altering every
+ * colorband of a tile before moving to the next tile. Each thread alters
+ * its own rows of the image in place. The tile and the halo around it are
+ * copied into a small buffer first, and the unaltered values the next
+ * tiles still need are kept from that copy. No new colorband is made.
+ *
+ * Only the copy knows about the edge of the image: rows and columns
+ * outside it are filled by the border mode, so the stencil itself runs
+ * the same loop everywhere. With a black border the pixels within halo of
+ * the edge are set to 0 instead.
+ *
+ * @param[in,out] img - image structure
+ * @param[in] halo - rows and columns the stencil reaches out on each side
+ * @param[in] stencil - stencil for one colorband of a tile. It is given the
+ * tile with its halo, with in[i][j] readable for i and j from -halo to
+ * halo past the rows and columns of the tile, and sets out[i][j] for
+ * every row and column of the tile.
+ *
+ *****************************************************************************/
+void tileStencil(image& img, int halo, const function<void(pixel** in,
+    pixel** out, int rows, int cols)>& stencil)
+{
+    pixel** bands[3] = { img.redgray, img.green, img.blue };
+    int rows = img.rows, cols = img.cols, channels = 0, c, i;
+    int height = max(tileRows, 2 * halo), width = max(tileCols, 2 * halo);
+    int lo = border == BLACK_BORDER ? halo : 0;
+    int threads = threadCount(rows - 2 * lo);
+    size_t span = (size_t)cols * halo;
+    vector<stencilSaves> saves(threads * 3);
+
+    for (c = 0; c < 3; c++)
+    {
+        if (bands[c] != nullptr)
+        {
+            bands[channels++] = bands[c];
+        }
+    }
+
+    if (rows > 2 * lo && cols > 2 * lo)
+    {
+        // keep the rows around each thread's rows before any are altered
+        parallelRows(rows - 2 * lo, threads, [&](int first, int last, int t)
+        {
+            int k, q;
+
+            first += lo;
+            last += lo;
+            for (k = 0; k < channels; k++)
+            {
+                stencilSaves& save = saves[t * 3 + k];
+                save.above.resize(span);
+                save.nextAbove.resize(span);
+                save.below.resize(span);
+                save.left.resize((size_t)height * halo);
+                save.leftPad.resize((size_t)height * halo);
+                save.rightPad.resize((size_t)height * halo);
+                for (q = 0; q < halo; q++)
+                {
+                    borderRow(&save.above[q * (size_t)cols], bands[k],
+                        first - halo + q, 0, cols, rows, cols);
+                    borderRow(&save.below[q * (size_t)cols], bands[k],
+                        last + q, 0, cols, rows, cols);
+                }
+            }
+        });
+
+        parallelRows(rows - 2 * lo, threads, [&](int first, int last, int t)
+        {
+            vector<pixel> tile((size_t)(height + 2 * halo) * (width + 2 * halo));
+            vector<pixel*> in(height + 2 * halo), out(height);
+            int stride = width + 2 * halo;
+            int i0, i1, j0, j1, n, w, k, q, x, right;
+            pixel* to;
+
+            first += lo;
+            last += lo;
+            for (i0 = first; i0 < last; i0 = i1)
+            {
+                i1 = min(i0 + height, last);
+                n = i1 - i0;
+
+                // the columns outside the image, before any are altered
+                for (k = 0; k < channels && lo == 0; k++)
+                {
+                    stencilSaves& save = saves[t * 3 + k];
+                    for (q = 0; q < n; q++)
+                    {
+                        borderCopy(&save.leftPad[q * (size_t)halo],
+                            bands[k][i0 + q], -halo, halo, cols);
+                        borderCopy(&save.rightPad[q * (size_t)halo],
+                            bands[k][i0 + q], cols, halo, cols);
+                    }
+                }
+
+                for (j0 = lo; j0 < cols - lo; j0 = j1)
+                {
+                    j1 = min(j0 + width, cols - lo);
+                    w = j1 - j0;
+                    right = min(j1 + halo, cols) - j0;
+                    for (k = 0; k < channels; k++)
+                    {
+                        stencilSaves& save = saves[t * 3 + k];
+
+                        // copy the unaltered tile and halo, in[q] is row
+                        // i0 - halo + q from column j0 - halo
+                        for (q = 0; q < n + 2 * halo; q++)
+                        {
+                            x = i0 - halo + q;
+                            to = &tile[q * (size_t)stride];
+                            in[q] = to + halo;
+                            if (x < i0)
+                            {
+                                borderCopy(to, &save.above[(x - i0 + halo) * (size_t)cols],
+                                    j0 - halo, w + 2 * halo, cols);
+                            }
+                            else if (x >= last)
+                            {
+                                borderCopy(to, &save.below[(x - last) * (size_t)cols],
+                                    j0 - halo, w + 2 * halo, cols);
+                            }
+                            else if (x >= i1)
+                            {
+                                borderCopy(to, bands[k][x], j0 - halo, w + 2 * halo, cols);
+                            }
+                            else {
+                                // left of the tile is altered or outside the image
+                                if (j0 > lo)
+                                {
+                                    memcpy(to, &save.left[(x - i0) * (size_t)halo], halo);
+                                }
+                                else if (lo == 0)
+                                {
+                                    memcpy(to, &save.leftPad[(x - i0) * (size_t)halo], halo);
+                                }
+                                else {
+                                    memcpy(to, bands[k][x] + j0 - halo, halo);
+                                }
+                                memcpy(to + halo, bands[k][x] + j0, right);
+                                if (right < w + halo)
+                                {
+                                    memcpy(to + halo + right, &save.rightPad[(x - i0)
+                                        * (size_t)halo], w + halo - right);
+                                }
+                            }
+                        }
+
+                        for (q = 0; q < n; q++)
+                        {
+                            out[q] = bands[k][i0 + q] + j0;
+                        }
+                        stencil(in.data() + halo, out.data(), n, w);
+
+                        // keep what the tiles to the right and below need
+                        for (q = 0; q < n; q++)
+                        {
+                            memcpy(&save.left[q * (size_t)halo], in[halo + q] + w - halo, halo);
+                        }
+                        for (q = 0; q < halo; q++)
+                        {
+                            memcpy(&save.nextAbove[q * (size_t)cols] + max(j0 - halo, 0),
+                                in[n + q] + max(j0 - halo, 0) - j0, right + j0
+                                - max(j0 - halo, 0));
+                        }
+                    }
+                }
+
+                for (k = 0; k < channels; k++)
+                {
+                    swap(saves[t * 3 + k].above, saves[t * 3 + k].nextAbove);
+                }
+            }
+        });
+    }
+
+    if (lo == 0) return;
+
+    // a black border has no full neighborhood
+    for (c = 0; c < channels; c++)
+    {
+        for (i = 0; i < rows; i++)
+        {
+            if (i < halo || i >= rows - halo || cols <= 2 * halo)
+            {
+                memset(bands[c][i], 0, cols);
+            }
+            else {
+                memset(bands[c][i], 0, halo);
+                memset(bands[c][i] + cols - halo, 0, halo);
+            }
+        }
+    }
+}
+
+static pixel* lineFetch(vector<lineBuffer>& buf, const vector<lineStage>& stages,
+    int s, int x, int rows, int cols, size_t& clock);
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Makes one row of the output of a stage of a pipeline, reading the rows
+ * of its input around it from the stage before. Input rows outside the
+ * image are filled by the border mode. With a black border the pixels
+ * within halo of the edge are set to 0 instead.
+ *
+ * @param[in,out] buf - rows kept for each stage
+ * @param[in] stages - stages of the pipeline
+ * @param[in] s - stage to make a row of
+ * @param[in] x - row to make
+ * @param[out] out - the row of each output colorband
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ * @param[in,out] clock - count of rows read, to find the oldest
+ *
+ *****************************************************************************/
+static void lineMake(vector<lineBuffer>& buf, const vector<lineStage>& stages,
+    int s, int x, pixel* const* out, int rows, int cols, size_t& clock)
+{
+    lineBuffer& b = buf[s];
+    int halo = s > 0 ? stages[s].halo : 0, width = 2 * halo + 1;
+    int c, q, r, edge;
+    pixel* from;
+
+    if (s > 0)
+    {
+        if (border == BLACK_BORDER && (x < halo || x >= rows - halo))
+        {
+            for (c = 0; c < stages[s].channels; c++)
+            {
+                memset(out[c], 0, cols);
+            }
+            return;
+        }
+
+        for (q = -halo; q <= halo; q++)
+        {
+            r = x + q;
+            if (r >= 0 && r < rows)
+            {
+                from = lineFetch(buf, stages, s - 1, r, rows, cols, clock);
+            }
+            else if (border == BLACK_BORDER || border == ZERO_BORDER)
+            {
+                from = nullptr;
+            }
+            else {
+                from = lineFetch(buf, stages, s - 1, borderIndex(r, rows),
+                    rows, cols, clock);
+            }
+
+            for (c = 0; c < stages[s - 1].channels; c++)
+            {
+                b.window[c * width + q + halo] = from == nullptr
+                    ? &b.zero[buf[s - 1].pad] : from + c * buf[s - 1].stride;
+            }
+        }
+        for (c = 0; c < stages[s - 1].channels; c++)
+        {
+            b.in[c] = &b.window[c * width + halo];
+        }
+    }
+
+    stages[s].row(x, s > 0 ? b.in.data() : nullptr, out, cols);
+
+    if (s > 0 && border == BLACK_BORDER)
+    {
+        edge = min(halo, cols);
+        for (c = 0; c < stages[s].channels; c++)
+        {
+            memset(out[c], 0, edge);
+            memset(out[c] + cols - edge, 0, edge);
+        }
+    }
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Finds a row of the output of a stage of a pipeline among the rows kept
+ * for it, making it in place of the row read longest ago if it is not
+ * there. The columns the next stage reaches past each side are filled by
+ * the border mode.
+ *
+ * @param[in,out] buf - rows kept for each stage
+ * @param[in] stages - stages of the pipeline
+ * @param[in] s - stage to read a row of
+ * @param[in] x - row to read, inside the image
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ * @param[in,out] clock - count of rows read, to find the oldest
+ *
+ * @returns returns the row of the first colorband, the row of colorband c
+ * is c strides after it
+ *
+ *****************************************************************************/
+static pixel* lineFetch(vector<lineBuffer>& buf, const vector<lineStage>& stages,
+    int s, int x, int rows, int cols, size_t& clock)
+{
+    lineBuffer& b = buf[s];
+    int channels = stages[s].channels, slot = 0, k, c;
+    pixel* out[3] = { nullptr, nullptr, nullptr };
+    pixel* row;
+
+    for (k = 0; k < (int)b.index.size(); k++)
+    {
+        if (b.index[k] == x)
+        {
+            b.used[k] = ++clock;
+            return &b.rows[(size_t)k * channels * b.stride + b.pad];
+        }
+        if (b.used[k] < b.used[slot])
+        {
+            slot = k;
+        }
+    }
+
+    for (c = 0; c < channels; c++)
+    {
+        out[c] = &b.rows[((size_t)slot * channels + c) * b.stride + b.pad];
+    }
+    lineMake(buf, stages, s, x, out, rows, cols, clock);
+
+    for (c = 0; c < channels; c++)
+    {
+        row = out[c];
+        borderCopy(row - b.pad, row, -b.pad, b.pad, cols);
+        borderCopy(row + cols, row, cols, b.pad, cols);
+    }
+    b.index[slot] = x;
+    b.used[slot] = ++clock;
+
+    return out[0];
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Runs stencils one after another over an image without storing what each
+ * one outputs. A row of the last stage is made straight into the output
+ * colorbands, pulling the rows it reads from the stage before, which pulls
+ * from the stage before it. Each stage keeps only the 2 * halo + 1 rows the
+ * next stage reads at once, so a chain of small stencils passes over main
+ * memory once instead of once per stage. Each thread runs the pipeline
+ * over its own rows, making again the few rows around them.
+ *
+ * @param[in] stages - stages of the pipeline, the first makes the rows the
+ * rest read, at most 3 colorbands each
+ * @param[out] dest - colorbands for the output of the last stage
+ * @param[in] rows - rows in the image
+ * @param[in] cols - columns in the image
+ *
+ *****************************************************************************/
+void linePipeline(const vector<lineStage>& stages, pixel** const* dest,
+    int rows, int cols)
+{
+    int count = (int)stages.size();
+
+    parallelRows(rows, threadCount(rows), [&](int first, int last, int)
+    {
+        vector<lineBuffer> buf(count);
+        pixel* out[3] = { nullptr, nullptr, nullptr };
+        size_t clock = 0;
+        int s, c, i, slots;
+
+        for (s = 0; s < count; s++)
+        {
+            lineBuffer& b = buf[s];
+            if (s + 1 < count)
+            {
+                b.pad = stages[s + 1].halo;
+                b.stride = cols + 2 * b.pad;
+                slots = 2 * b.pad + 1;
+                b.rows.resize((size_t)slots * stages[s].channels * b.stride);
+                b.index.assign(slots, -1);
+                b.used.assign(slots, 0);
+            }
+            if (s > 0)
+            {
+                b.zero.assign(buf[s - 1].stride, 0);
+                b.window.resize(stages[s - 1].channels * (2 * stages[s].halo + 1));
+                b.in.resize(stages[s - 1].channels);
+            }
+        }
+
+        for (i = first; i < last; i++)
+        {
+            for (c = 0; c < stages[count - 1].channels; c++)
+            {
+                out[c] = dest[c][i];
+            }
+            lineMake(buf, stages, count - 1, i, out, rows, cols, clock);
+        }
+    });
+}
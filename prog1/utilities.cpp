@@ -95,4 +95,78 @@ int roundAngle(double angle)
 bool inBetween(double num, double lower, double upper)
 {
     return num <= upper && num > lower;
-}
\ No newline at end of file
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Counts the colorbands of an image, a grayscale image only has the
+ * red/gray colorband
+ *
+ * @param[in] img - image structure
+ *
+ * @returns returns 1 for a grayscale image, 3 for a color image
+ *
+ *****************************************************************************/
+int imageChannels(const image& img)
+{
+    return img.green == nullptr ? 1 : 3;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Decides how many threads to split the rows of an image between, so that
+ * each thread gets at least MIN_THREAD_ROWS rows
+ *
+ * @param[in] rows - rows in the image
+ *
+ * @returns returns the number of threads, at least 1
+ *
+ *****************************************************************************/
+int threadCount(int rows)
+{
+    int threads = (int)thread::hardware_concurrency();
+
+    threads = min(threads, rows / MIN_THREAD_ROWS);
+
+    return max(threads, 1);
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Splits the rows of an image into equal bands and does some work on each
+ * band in its own thread, waiting for all of them to finish
+ *
+ * @param[in] rows - rows in the image
+ * @param[in] threads - number of threads, from threadCount
+ * @param[in] work - work to do, given the first row, one past the last row
+ * and the number of the thread
+ *
+ *****************************************************************************/
+void parallelRows(int rows, int threads, const function<void(int, int, int)>& work)
+{
+    vector<thread> workers;
+    int t;
+
+    if (threads <= 1)
+    {
+        work(0, rows, 0);
+        return;
+    }
+
+    for (t = 0; t < threads; t++)
+    {
+        workers.push_back(thread(work, (int)((long long)rows * t / threads),
+            (int)((long long)rows * (t + 1) / threads), t));
+    }
+
+    for (t = 0; t < threads; t++)
+    {
+        workers[t].join();
+    }
+}
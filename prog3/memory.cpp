@@ -99,61 +99,57 @@ void copy2D(pixel**& src, pixel**& dest, int rows, int cols)
  * @author Adam Kraus
  *
  * @par Description:
- * Dynamically allocates a 2D boolean array
+ * Dynamically allocates a bit map with one bit per pixel, stored as one
+ * contiguous array of words
  *
- * @param[in] rows - number of rows in the array
- * @param[in] cols - number of columns in the array
+ * @param[in] rows - number of rows in the map
+ * @param[in] cols - number of columns in the map
  *
- * @returns returns the pointer to the 2D array
+ * @returns returns the bit map
  *
  *****************************************************************************/
-bool** alloc2DBool(int rows, int cols)
+bitMap allocBitMap(int rows, int cols)
 {
-    bool** iptr = nullptr;
-    int i;
+    bitMap map;
 
-    iptr = new (nothrow) bool* [rows];
-    if (iptr == nullptr)
+    map.rows = rows;
+    map.cols = cols;
+    map.words = ((size_t)rows * cols + WORD_BITS - 1) / WORD_BITS;
+    map.bits = new (nothrow) uint64_t[map.words];
+    if (map.bits == nullptr)
     {
-        cout << "Not enough memory to run program." << endl;
-        free2DBool(iptr, rows);
+        cout << "Not enough memory to run program" << endl;
         exit(1);
     }
 
-    for (i = 0; i < rows; i++)
-    {
-        iptr[i] = new (nothrow) bool[cols];
-        if (iptr[i] == nullptr)
-        {
-            cout << "Not enough memory to run program" << endl;
-            free2DBool(iptr, rows);
-            exit(1);
-        }
-    }
-
-    return iptr;
+    return map;
 }
 
 /** ***************************************************************************
  * @author Adam Kraus
  *
  * @par Description:
- * Frees memory from a dynamically allocated 2D boolean array
+ * Frees memory from a dynamically allocated bit map
  *
- * @param[in] ptr - pointer to the 2D array
- * @param[in] rows - number rows in the array
+ * @param[in,out] map - the bit map
  *
  *****************************************************************************/
-void free2DBool(bool**& ptr, int rows)
+void freeBitMap(bitMap& map)
 {
-    int i;
-
-    if (ptr == nullptr) return;
-
-    for (i = 0; i < rows; i++)
-    {
-        delete[] ptr[i];
-    }
+    delete[] map.bits;
+    map.bits = nullptr;
+}
 
-    delete[] ptr;
-}
\ No newline at end of file
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Clears every bit in a bit map a word at a time
+ *
+ * @param[in,out] map - the bit map
+ *
+ *****************************************************************************/
+void clearBitMap(bitMap& map)
+{
+    memset(map.bits, 0, map.words * sizeof(uint64_t));
+}
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -52,6 +53,22 @@ struct image
     pixel** blue;    /**< 2D array for blue color values */
 };
 
+/**
+ * @brief Bits in each word of a bit map
+ */
+const int WORD_BITS = 64;
+
+/**
+ * @brief Holds one bit for each pixel of an image
+ */
+struct bitMap
+{
+    int rows;       /**< Number of rows in the map */
+    int cols;       /**< Number of columns in the map */
+    size_t words;   /**< Number of words in the bits array */
+    uint64_t* bits; /**< Bits of the map, row by row */
+};
+
 /**
  * @brief Magic Number of P3
  */
@@ -76,6 +93,45 @@ void writeBIN(ofstream& file, image& img);
 pixel** alloc2D(int rows, int cols);
 void free2D(pixel**& ptr, int rows);
 void copy2D(pixel**& ptr1, pixel**& ptr2, int rows, int cols);
-bool** alloc2DBool(int rows, int cols);
-void free2DBool(bool**& ptr, int rows);
+bitMap allocBitMap(int rows, int cols);
+void freeBitMap(bitMap& map);
+void clearBitMap(bitMap& map);
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Tests the bit of a pixel in a bit map
+ *
+ * @param[in] map - the bit map
+ * @param[in] row - row of the pixel
+ * @param[in] col - column of the pixel
+ *
+ * @returns returns true if the bit is set
+ *
+ *****************************************************************************/
+inline bool testBit(const bitMap& map, int row, int col)
+{
+    size_t bit = (size_t)row * map.cols + col;
+
+    return (map.bits[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+/** ***************************************************************************
+ * @author Adam Kraus
+ *
+ * @par Description:
+ * Sets the bit of a pixel in a bit map
+ *
+ * @param[in,out] map - the bit map
+ * @param[in] row - row of the pixel
+ * @param[in] col - column of the pixel
+ *
+ *****************************************************************************/
+inline void setBit(bitMap& map, int row, int col)
+{
+    size_t bit = (size_t)row * map.cols + col;
+
+    map.bits[bit / WORD_BITS] |= (uint64_t)1 << (bit % WORD_BITS);
+}
 #endif
\ No newline at end of file
@@ -55,9 +55,8 @@
 
 #include "netPBM.h"
 
-void imageFill(image& img, bool** used, int row, int col, int origRed,
+void imageFill(image& img, bitMap& used, int row, int col, int origRed,
     int origGreen, int origBlue, int fillRed, int fillGreen, int fillBlue);
-void initBool(bool** ptr, int rows, int cols);
 
 /** ***************************************************************************
  * @author Adam Kraus
@@ -79,7 +78,7 @@ int main(int argc, char** argv)
     vector<string> comments;
     image img;
     int row, col, rows, cols, red, green, blue, maxVal;
-    bool** used;
+    bitMap used;
 
     // check command line argument count
     if (argc != 7)
@@ -122,9 +121,9 @@ int main(int argc, char** argv)
     closeFileIn(fin);
     openFileOut(fout, imageName);
 
-    // create boolean array
-    used = alloc2DBool(rows, cols);
-    initBool(used, rows, cols);
+    // create bit map of changed pixels
+    used = allocBitMap(rows, cols);
+    clearBitMap(used);
 
     // recursive stuff here
     imageFill(img, used, row, col, img.redgray[row][col], img.green[row][col], 
@@ -144,7 +143,7 @@ int main(int argc, char** argv)
     free2D(img.redgray, rows);
     free2D(img.blue, rows);
     free2D(img.green, rows);
-    free2DBool(used, rows);
+    freeBitMap(used);
     closeFileOut(fout);
 }
 
@@ -155,8 +154,7 @@ int main(int argc, char** argv)
  * Recursively changes pixel values to fill a region.
  *
  * @param[in,out] img - image structure
- * @param[in] used - 2d array of booleans to determine if a pixel has been
- * changed
+ * @param[in] used - bit map to determine if a pixel has been changed
  * @param[in] row - row of pixel to change
  * @param[in] col - column of pixel to change
  * @param[in] origRed - red color value of origin pixel before it was changed
@@ -168,13 +166,13 @@ int main(int argc, char** argv)
  * @param[in] fillBlue - blue color value to change pixel to
  *
  *****************************************************************************/
-void imageFill(image& img, bool** used, int row, int col, int origRed, 
+void imageFill(image& img, bitMap& used, int row, int col, int origRed, 
     int origGreen, int origBlue, int fillRed, int fillGreen, int fillBlue)
 {
     // check if in image boundary, if pixel has been changed, and if pixel
     // matches origin pixel color
     if (row < 0 || row >= img.rows || col < 0 || col >= img.cols ||
-        used[row][col] || img.redgray[row][col] != origRed || 
+        testBit(used, row, col) || img.redgray[row][col] != origRed || 
         img.green[row][col] != origGreen || img.blue[row][col] != origBlue)
     {
         return;
@@ -186,7 +184,7 @@ void imageFill(image& img, bool** used, int row, int col, int origRed,
     img.blue[row][col] = fillBlue;
 
     // mark pixel as changed
-    used[row][col] = true;
+    setBit(used, row, col);
 
     // recursively change pixels in each direction
     imageFill(img, used, row - 1, col, origRed, origGreen, origBlue,
@@ -197,28 +195,4 @@ void imageFill(image& img, bool** used, int row, int col, int origRed,
         fillRed, fillGreen, fillBlue);
     imageFill(img, used, row, col + 1, origRed, origGreen, origBlue,
         fillRed, fillGreen, fillBlue);
-}
-
-/** ***************************************************************************
- * @author Adam Kraus
- *
- * @par Description:
- * Initializes all values in a 2D boolean array to false
- *
- * @param[in,out] ptr - pointer to the 2D boolean array
- * @param[in] rows - rows in the 2D array
- * @param[in] cols - columns in the 2D array
- *
- *****************************************************************************/
-void initBool(bool** ptr, int rows, int cols)
-{
-    int i, j;
-
-    for (i = 0; i < rows; i++)
-    {
-        for (j = 0; j < cols; j++)
-        {
-            ptr[i][j] = false;
-        }
-    }
 }
\ No newline at end of file